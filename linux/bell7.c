@@ -1,72 +1,258 @@
+#include "constructAndRank.h"
+#include <stdatomic.h>
 
-#include <stdio.h>
-#include <stdlib.h>
-
-// The max value of n we could have. This is because we are storing 
-// n! in a unsigned long long which enables us to go up to 20! which 
-// is more than enough as we will hit memory limits before we hit this limit
-#define maxN 20 
-
-int  n;            
-unsigned long long fact;  
-int  a[maxN];     
-int *U;            
-long write_pos = 0;
+// State for the recursive version of the algorithm
+static int  n;            
+static int  a[maxN];     
+static int *U;            
+static unsigned long long length;
+static unsigned long long write_pos = 0;
 
 // Helper function to rotate a from 0...k to the right
-static void rotateRight(int k){
+static void rotateRight(int *a, int k){
     int tmp = a[k];
     for (int i = k; i > 0; i--) a[i] = a[i-1];
     a[0] = tmp;
 }
 
 // Helper function to append a[n-1] into U
-void visit(){
+static void visit(){
   // If we have not filled the array yet then append 
-  if (write_pos < fact) U[write_pos++] = a[n-1];
+  if (write_pos < length) U[write_pos++] = a[n-1];
 }
 
 // Recursive implementation of the bell7 algorithm
 // as presented in the Holroyd-Ruskey-Williams paper
-void Bell7(int m){
+static void Bell7(int m){
     if (m == n){
         visit();
     }else{
         Bell7(m+1);
         for (int i = 0; i < m; i++){
-            rotateRight(m);
+            rotateRight(a, m);
             Bell7(m+1);
         }
-        rotateRight(m);
+        rotateRight(a, m);
     }
 }
 
-int main(int argc, char **argv){
-    printf("Enter n: ");
-    scanf("%d", &n);
-  
-    if (n < 1 || n > maxN) {
+// Generate the 7-order shorthand universal cycle for Π(n) with the 
+// recursive Bell7 algorithm. Returns an array of n! ints or NULL.
+// This transcription of Bell7 only gives a universal cycle for n ≤ 4,
+// from n = 5 on some windows repeat (n = 5 has 114 distinct windows and
+// 6 that are not permutations at all). The iterative and parallel 
+// versions below follow it symbol for symbol so they share the problem
+int * generateBell7Cycle(int size){
+    if (size < 1 || size > maxN) {
         fprintf(stderr, "Error: n must be between 1 and %d\n", maxN);
-        return 1;
+        return NULL;
     }
 
-    fact = factorial(n);
-    U = malloc(fact * sizeof(int));
+    n = size;
+    length = factorial(n);
+    write_pos = 0;
+    U = malloc(length * sizeof(int));
     if (!U) {
         fprintf(stderr, "Error allocating memory -> terminating program\n\n");
-        return 1;
+        return NULL;
     }
 
     // Initialize a to n,n-1...1
     for (int i = 0; i < n; i++) a[i] = n - i;
     
     Bell7(1);
+    return U;
+}
 
-    // output the UC that we just generated
-    for (unsigned long long i = 0; i < fact; i++) printf("%d", U[i]);
-    
-    printf("\n");
+// An iterative version of Bell7 that can stop after any number of 
+// symbols and pick up again later. The recursion is replaced by a 
+// counter per level, c[m] is how many times level m has rotated so 
+// far (0..m), which is all the call stack of Bell7(m) remembers. 
+// Every leaf of the recursion outputs one symbol
+struct Bell7Stream {
+    int n;
+    int lo;                       // the level this stream started at
+    int a[maxN];
+    int c[maxN + 1];
+    unsigned long long emitted;   // symbols handed out so far
+    unsigned long long total;     // n! symbols in the whole cycle
+};
+
+// Open a generator for the 7-order universal cycle for Π(n).
+// Returns NULL if n is out of range or memory allocation failed
+Bell7Stream * bell7_open(int n){
+    if (n < 1 || n > maxN) return NULL;
+
+    Bell7Stream *g = calloc(1, sizeof(Bell7Stream));
+    if (!g) return NULL;
+
+    g->n = n;
+    g->lo = 1;
+    g->total = factorial(n);
+
+    // Initialize a to n,n-1...1, the first leaf is reached 
+    // straight away since nothing rotates on the way down
+    for (int i = 0; i < n; i++) g->a[i] = n - i;
+    return g;
+}
+
+// Move from one leaf of the recursion to the next. Levels below the 
+// deepest one that still has rotations left are finished, so they do
+// their final rotation and return. That level then rotates and we go
+// back down to a leaf with all of the levels below it starting over
+static void bell7Next(Bell7Stream *g){
+    int m = g->n - 1;
+    while (m >= g->lo && g->c[m] == m){
+        rotateRight(g->a, m);
+        g->c[m] = 0;
+        m--;
+    }
+    if (m < g->lo) return;
+
+    g->c[m]++;
+    rotateRight(g->a, m);
+}
+
+// Write the next (up to) len symbols of the cycle into buf. Returns the
+// number of symbols written, which is 0 once the whole cycle has been read
+unsigned long long bell7_fill(Bell7Stream *g, unsigned char *buf, unsigned long long len){
+    unsigned long long left = g->total - g->emitted;
+    if (len > left) len = left;
+
+    for (unsigned long long i = 0; i < len; i++){
+        buf[i] = g->a[g->n - 1];
+        bell7Next(g);
+    }
+
+    g->emitted += len;
+    return len;
+}
+
+void bell7_close(Bell7Stream *g){
+    free(g);
+}
+
+// Every call of Bell7(m) leaves a unchanged (its m+1 rotations of 
+// a[0..m] undo each other and its children leave a unchanged too), so
+// the subtrees at depth d are independent of each other. The subtree 
+// where level m has rotated c[m] times, for m = 1..d-1, starts with a 
+// rotated c[1] times at level 1, then c[2] times at level 2 and so on, 
+// and it writes the n!/d! symbols starting at the mixed radix index of
+// c[1..d-1] (level 1 most significant) times n!/d!
+
+// One worker of the pool. Each worker owns a range of subtrees and 
+// takes them from the front, once its own range is empty it steals 
+// from the front of the other workers' ranges
+typedef struct {
+    _Atomic unsigned long long next;
+    unsigned long long end;
+} Bell7Range;
+
+typedef struct {
+    int n, depth, workers, self;
+    unsigned long long perTree;
+    Bell7Range *ranges;
+    UCBuffer *UC;
+} Bell7Worker;
 
-    free(U);
-    return 0;
-}
\ No newline at end of file
+// Generate the subtree with the given index at depth d into UC
+static void bell7Subtree(Bell7Worker *w, unsigned long long tree){
+    Bell7Stream g = { 0 };
+    g.n = w->n;
+    g.lo = w->depth;
+    g.total = w->perTree;
+
+    // Decode the rotation counts of the levels above the subtree
+    int c[maxN + 1];
+    unsigned long long idx = tree;
+    for (int m = w->depth - 1; m >= 1; m--){
+        c[m] = idx % (m + 1);
+        idx /= (m + 1);
+    }
+    for (int i = 0; i < w->n; i++) g.a[i] = w->n - i;
+    for (int m = 1; m < w->depth; m++) for (int r = 0; r < c[m]; r++) rotateRight(g.a, m);
+
+    unsigned char block[1 << 14];
+    unsigned long long pos = tree * w->perTree, got;
+    while ((got = bell7_fill(&g, block, sizeof(block))) > 0){
+        if (w->UC->mode == UC_BYTE) memcpy((unsigned char *)w->UC->data + pos, block, got);
+        else for (unsigned long long i = 0; i < got; i++) setSymbol(w->UC, pos + i, block[i]);
+        pos += got;
+    }
+}
+
+// Take the next subtree out of range r, returns 0 if it is empty
+static int bell7Take(Bell7Range *r, unsigned long long *tree){
+    if (atomic_load(&r->next) >= r->end) return 0;
+    *tree = atomic_fetch_add(&r->next, 1);
+    return *tree < r->end;
+}
+
+static void * bell7Work(void *arg){
+    Bell7Worker *w = arg;
+    unsigned long long tree;
+
+    while (bell7Take(&w->ranges[w->self], &tree)) bell7Subtree(w, tree);
+
+    // Our own range is done so help the others finish theirs
+    for (int v = 1; v < w->workers; v++){
+        Bell7Range *victim = &w->ranges[(w->self + v) % w->workers];
+        while (bell7Take(victim, &tree)) bell7Subtree(w, tree);
+    }
+    return NULL;
+}
+
+// Generate the 7-order universal cycle for Π(n) into a buffer with a pool
+// of threads, splitting the Bell7 recursion into the d! subtrees at the
+// given depth (1 ≤ depth ≤ n-1). If depth is 0 one is picked that gives
+// every thread a few subtrees. Every subtree writes its own part of the
+// buffer so no locking is needed
+UCBuffer * generateBell7Parallel(int n, int mode, int depth, int threads){
+    if (n < 1 || n > maxN) return NULL;
+    unsigned long long total = factorial(n);
+    if (threads < 1) threads = 1;
+
+    // Pick a depth with at least 8 subtrees per thread
+    if (depth <= 0){
+        depth = 1;
+        while (depth < n - 1 && factorial(depth) < 8ull * threads) depth++;
+    }
+    if (depth > n - 1) depth = n - 1;
+    if (depth < 1) depth = 1;
+
+    // Packed subtrees must not share a word of the buffer
+    while (mode == UC_PACKED && depth > 1 && (total / factorial(depth)) % 64 != 0) depth--;
+
+    UCBuffer *UC = newUCBuffer(n, total, mode);
+    unsigned long long trees = factorial(depth);
+    pthread_t *tid = malloc(threads * sizeof(pthread_t));
+    Bell7Range *ranges = malloc(threads * sizeof(Bell7Range));
+    Bell7Worker *workers = malloc(threads * sizeof(Bell7Worker));
+    if (!UC || !tid || !ranges || !workers){
+        fprintf(stderr, "Memory allocation failed\n");
+        freeUCBuffer(UC);
+        free(tid);
+        free(ranges);
+        free(workers);
+        return NULL;
+    }
+
+    // Hand every worker an even share of the subtrees to start with
+    for (int t = 0; t < threads; t++){
+        atomic_init(&ranges[t].next, trees * t / threads);
+        ranges[t].end = trees * (t + 1) / threads;
+        workers[t] = (Bell7Worker){ n, depth, threads, t, total / trees, ranges, UC };
+    }
+
+    // The calling thread is worker 0
+    int *started = calloc(threads, sizeof(int));
+    for (int t = 1; t < threads; t++) started[t] = pthread_create(&tid[t], NULL, bell7Work, &workers[t]) == 0;
+    bell7Work(&workers[0]);
+    for (int t = 1; t < threads; t++) if (started[t]) pthread_join(tid[t], NULL);
+
+    free(started);
+    free(tid);
+    free(ranges);
+    free(workers);
+    return UC;
+}
@@ -1,5 +1,20 @@
 #include "constructAndRank.h"
 
+unsigned long long fact;
+
+// Helper function to compute n!
+// By storing n! as an unsigned long long we can compute
+// and store values of n factorial that are less than or equal 
+// to 20. This is more than enough for our purposes as to store 
+// the bitstring for n = 20 we would need 20! = 2,432,902,008,176,640,000 
+// bytes which is 2.4 exabytes, far more than any current computer 
+// can store in memory 
+unsigned long long factorial(unsigned int n){
+  unsigned long f = 1;
+  for (unsigned int i = 2; i <= n; i++) f *= i;
+  return f;
+}
+
 // Helper function to rotate a string of size n to the left
 void rotate_n(int *p, int n){
     int first = p[0];
@@ -15,83 +30,314 @@ void rotate_n_minus_1(int *p, int n){
     p[n-2] = first;
 }
   
-// Generate the bitstring Sₙ for n ≥ 2, using the 
-// loopless algorithm prestented in the Ruskey–Williams paper
-char * genBitString(int n){
-    // Set up arrays for the algorithm
-    int *a = calloc(n + 2, sizeof(int));
-    int *d = malloc((n + 2) * sizeof(int));
-    int *f = malloc((n + 1) * sizeof(int));
-
-    char *bitstring = malloc((fact + 1) * sizeof(char));
+// Rotate the first k elements of p to the left by r positions
+static void rotate_left_by(int *p, int k, int r){
+    if (r == 0) return;
+    int tmp[k];
+    for (int i = 0; i < k; i++) tmp[i] = p[(i + r) % k];
+    for (int i = 0; i < k; i++) p[i] = tmp[i];
+}
 
-    // Check if memory allocation was successful
-    if (!bitstring || !a || !d || !f){
-        fprintf(stderr, "Memory allocation failed\n");
-        return NULL;
-    }
+// The state of the loopless algorithm prestented in the Ruskey–Williams 
+// paper. The arrays are indexed from 1 to n+1 as they are in the paper
+typedef struct {
+    int n;
+    int a[maxN + 2];
+    int d[maxN + 2];
+    int f[maxN + 2];
+} LooplessState;
 
-    unsigned long long bitlen = 0;
-    int j;
+static void looplessInit(LooplessState *s, int n){
+    s->n = n;
+    memset(s->a, 0, sizeof(s->a));
 
     // Initially do dₙ...d₁ <- 1...1
     // and fₙ, fₙ₋₁...f₁ <- n + 1, n-1...1 
     for (int i = 1; i < n; i++){
-        d[i] = 1;
-        f[i] = i;
+        s->d[i] = 1;
+        s->f[i] = i;
     }
-    d[n] = 1;
-    f[n] = n + 1;
+    s->d[n] = 1;
+    s->f[n] = n + 1;
 
     // This is a error in the original paper, d[n+1] is never defined
     // in the pseudocode however it is used by the algorithm. The max 
     // value of j is n+1 so we need to ensure that d[n+1] exists when 
     // the program attempts to access it. 
-    d[n+1] = 1;
+    s->d[n+1] = 1;
+}
 
-    do{
-        // Grab and then reset the first element of f
-        j = f[1];
-        f[1] = 1;
-
-        // Now if j is even XOR (a[j] - d[j] ≤ 0 OR a[j] - d[j] ≥ n - j), then
-        // the next bit is 0, otherwise it is 1
-        int diff = a[j] - d[j];
-        int flip = ((j % 2 == 0) ^ (diff <= 0 || diff >= (n - j)));
-        bitstring[bitlen++] = flip ? '0' : '1';
-        a[j] = a[j] + d[j];
-
-        // Check to see if we need to update d[j] and f[j]
-        if (a[j] == 0 || a[j] == n - j){
+// Run one step of the loopless algorithm and return the next bit of Sₙ,
+// 0 for a σₙ and 1 for a σₙ₋₁. The index j that was updated is stored 
+// in *jp, the algorithm is finished once j reaches n
+static inline int looplessNext(LooplessState *s, int *jp){
+    int n = s->n;
+    int *a = s->a, *d = s->d, *f = s->f;
+
+    // Grab and then reset the first element of f
+    int j = f[1];
+    f[1] = 1;
+
+    // Now if j is even XOR (a[j] - d[j] ≤ 0 OR a[j] - d[j] ≥ n - j), then
+    // the next bit is 0, otherwise it is 1
+    int diff = a[j] - d[j];
+    int flip = ((j % 2 == 0) ^ (diff <= 0 || diff >= (n - j)));
+    a[j] = a[j] + d[j];
+
+    // Check to see if we need to update d[j] and f[j]
+    if (a[j] == 0 || a[j] == n - j){
         d[j] = -d[j];
         f[j] = f[j + 1];
         f[j + 1] = j + 1;
+    }
+
+    *jp = j;
+    return !flip;
+}
+
+// Put the loopless algorithm in the state it is in just before step k
+// (0 ≤ k < n!) without running the first k steps. The algorithm walks 
+// a reflected mixed radix Gray code where digit t = 1..n-1 takes the 
+// values 0..n-t (digit 1 changing fastest), so a and d follow directly
+// from the mixed radix digits of k. A digit is passive once it has 
+// finished its sweep in the current direction, and the focus pointer
+// at the start of a block of passive digits points past the block
+static void looplessSeek(LooplessState *s, int n, unsigned long long k){
+    looplessInit(s, n);
+
+    int passive[maxN + 2] = {0};
+    unsigned long long w = 1;
+    for (int t = 1; t < n; t++){
+        int m = n - t + 1;
+        unsigned long long q = k / w;
+        int c = q % m;
+
+        // Every other sweep of a digit runs backwards
+        int reflected = (q / m) & 1;
+        s->a[t] = reflected ? m - 1 - c : c;
+        passive[t] = (c == m - 1);
+        s->d[t] = (reflected ^ passive[t]) ? -1 : 1;
+        w *= m;
+    }
+
+    for (int t = 1; t < n; t++){
+        if (!passive[t] || (t > 1 && passive[t-1])) continue;
+        int q = t;
+        while (q < n && passive[q]) q++;
+        s->f[t] = (q == n) ? n + 1 : q;
+    }
+    if (n > 1 && passive[n-1]) s->f[n] = n;
+}
+
+// Return bit k of Sₙ straight from k, 1 for a σₙ₋₁ and 0 for a σₙ. 
+// Step k of the loopless algorithm updates the first digit of k (in the
+// mixed radix of looplessSeek) that has not finished its sweep, so only
+// the digits up to that one are needed, O(1) on average and O(n) at worst
+static int looplessBitAt(int n, unsigned long long k){
+    unsigned long long w = 1;
+    for (int j = 1; j < n; j++){
+        int m = n - j + 1;
+        unsigned long long q = k / w;
+        int c = q % m;
+        if (c != m - 1){
+            int reflected = (q / m) & 1;
+            int a = reflected ? m - 1 - c : c;
+            int d = reflected ? -1 : 1;
+
+            // The same test as looplessNext
+            int diff = a - d;
+            return !((j % 2 == 0) ^ (diff <= 0 || diff >= (n - j)));
         }
+        w *= m;
+    }
+
+    // Every digit has finished its sweep on the last step, which has 
+    // j = n + 1 with a = 0 and d = 1 so the test comes down to j's parity
+    return (n + 1) % 2 == 0;
+}
+
+// The working permutation kept so that both σₙ and σₙ₋₁ cost O(1) 
+// instead of shifting the whole array. The first n-1 elements live in
+// a ring starting at head and the last element sits in a pinned tail 
+// slot. σₙ₋₁ only has to advance head. σₙ moves perm[0] to the back, 
+// which is the same as swapping perm[0] with the tail and then 
+// advancing head. The ring is stored twice in a row so that 
+// perm[0..n-2] can always be read as ring[head..head+n-2]
+typedef struct {
+    int k;                  // the ring holds k = n-1 elements
+    int head;               // index of perm[0] in the ring
+    int tail;               // perm[n-1]
+    int ring[2 * maxN];
+} RotState;
+
+// Start from the permutation n, n-1, ..., 1
+static void rotInit(RotState *r, int n){
+    r->k = n - 1;
+    r->head = 0;
+    r->tail = 1;
+    r->ring[0] = n;   // for n = 1 the ring is empty but perm[0] is still read
+    for (int i = 0; i < r->k; i++) r->ring[i] = r->ring[i + r->k] = n - i;
+}
+
+// Put the ring at the permutation perm
+static void rotSet(RotState *r, int n, const int *perm){
+    r->k = n - 1;
+    r->head = 0;
+    r->tail = perm[n - 1];
+    r->ring[0] = perm[0];
+    for (int i = 0; i < r->k; i++) r->ring[i] = r->ring[i + r->k] = perm[i];
+}
+
+// Put the ring at the permutation used for symbol k of the cycle. 
+// The cycle visits the permutations in Ruskey–Williams rank order 
+// (the window starting at k completed with its missing symbol has 
+// rank k) so this is just an unranking
+static void rotSeek(RotState *r, int n, unsigned long long k){
+    int perm[maxN];
+    unrankRuskeyWilliams(k, n, perm);
+    rotSet(r, n, perm);
+}
+
+// Apply σₙ₋₁ if bit is 1 or σₙ if bit is 0
+static inline void rotStep(RotState *r, int bit){
+    if (!bit){
+        int first = r->ring[r->head];
+        r->ring[r->head] = r->ring[r->head + r->k] = r->tail;
+        r->tail = first;
+    }
+    if (++r->head == r->k) r->head = 0;
+}
+
+// Run the loopless algorithm and store each bit of Sₙ either as a 
+// '0'/'1' char in bitstring or packed 64 to a word in words (bit i of
+// Sₙ is bit i % 64 of word i / 64), whichever one is not NULL. 
+// Returns the number of bits generated
+static unsigned long long runLoopless(int n, char *bitstring, unsigned long long *words){
+    LooplessState s;
+    looplessInit(&s, n);
+
+    unsigned long long bitlen = 0;
+    int j;
+
+    do{
+        int bit = looplessNext(&s, &j);
+        if (bitstring) bitstring[bitlen] = bit ? '1' : '0';
+        else if (bit) words[bitlen >> 6] |= 1ull << (bitlen & 63);
+        bitlen++;
     } while (j < n);
 
+    return bitlen;
+}
+
+// Generate the bitstring Sₙ for n ≥ 2, using the 
+// loopless algorithm prestented in the Ruskey–Williams paper
+char * genBitString(int n){
+    char *bitstring = malloc((factorial(n) + 1) * sizeof(char));
+
+    // Check if memory allocation was successful
+    if (!bitstring){
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    unsigned long long bitlen = runLoopless(n, bitstring, NULL);
+
     // Add null terminator for ease of use 
     bitstring[bitlen] = '\0';
 
-    // Clean up allocated memory
-    free(a);
-    free(d);
-    free(f);
-
     return bitstring;
 }
 
-// Generate the shorthand universal cycle for Π(n),
-// using the loopless σₙ/σₙ₋₁ algorithm of Ruskey–Williams
-int * generateUniversalCycle(int n){
+// Generate the bitstring Sₙ for n ≥ 2 packed 64 bits to a word, where a 
+// set bit is a σₙ₋₁ ('1') and a clear bit is a σₙ ('0'). This needs n!/8
+// bytes instead of the n! bytes used by genBitString
+unsigned long long * genBitStringPacked(int n){
+    unsigned long long *words = calloc((factorial(n) + 63) / 64, sizeof(unsigned long long));
+
+    // Check if memory allocation was successful
+    if (!words){
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    runLoopless(n, NULL, words);
+    return words;
+}
+
+// Apply the σₙ/σₙ₋₁ rotations for the next count (≤ 64) bits of Sₙ, held 
+// in the packed word w, to perm and write the count symbols they produce 
+// to UC starting at index pos. Rather than testing one bit at a time we 
+// split the word into runs of equal bits with ctz, since Sₙ is made of 
+// runs of n-3 or n-2 σₙ₋₁'s between runs of 2 or 3 σₙ's. A run of len 
+// rotations of the first k elements emits perm[0], perm[1]... cyclically
+// and then costs a single rotation by len % k
+static void consumeWord(UCBuffer *UC, unsigned long long pos, unsigned long long w,
+                        int count, int *perm, int n){
+    int t = 0;
+    while (t < count){
+        unsigned long long rest = w >> t;
+        int bit = rest & 1;
+
+        // Find the length of the run of equal bits starting at t
+        unsigned long long other = bit ? ~rest : rest;
+        int len = other ? __builtin_ctzll(other) : 64 - t;
+        if (len > count - t) len = count - t;
+
+        // σₙ₋₁ rotates the first n-1 elements and σₙ all n of them
+        int k = bit ? n - 1 : n;
+        for (int s = 0; s < len; s++) setSymbol(UC, pos + t + s, perm[s % k]);
+        rotate_left_by(perm, k, len % k);
+
+        t += len;
+    }
+}
+
+// Allocate a buffer for len symbols of a universal cycle for Π(n)
+// stored in the given mode. Returns NULL if the allocation fails
+UCBuffer * newUCBuffer(int n, unsigned long long len, int mode){
+    UCBuffer *uc = malloc(sizeof(UCBuffer));
+    if (!uc) return NULL;
+
+    uc->mode = mode;
+    uc->len = len;
+    uc->bits = (n <= 15) ? 4 : 5;
+
+    if (mode == UC_INT) uc->data = malloc((len + 1) * sizeof(int));
+    else if (mode == UC_BYTE) uc->data = malloc(len + 1);
+    else{
+        // One extra word so that a symbol straddling the last 
+        // word boundary can always be read with two loads
+        unsigned long long words = (len * uc->bits + 63) / 64 + 1;
+        uc->data = calloc(words, sizeof(unsigned long long));
+    }
+
+    if (!uc->data){
+        free(uc);
+        return NULL;
+    }
+    return uc;
+}
+
+void freeUCBuffer(UCBuffer *uc){
+    if (!uc) return;
+    free(uc->data);
+    free(uc);
+}
+
+// Generate the shorthand universal cycle for Π(n) into a buffer
+// stored in the given mode (UC_INT, UC_BYTE or UC_PACKED), using 
+// the loopless σₙ/σₙ₋₁ algorithm of Ruskey–Williams
+UCBuffer * generateUniversalCycleBuffer(int n, int mode){
     if (n < 2){
-        int *result = malloc(sizeof(int));
-        result[0] = n;
+        UCBuffer *result = newUCBuffer(n, 1, mode);
+        if (result) setSymbol(result, 0, n);
         return result;
     }
+    if (n > maxN) return NULL;
 
-    // Generate Sₙ into bitstring[] 
-    char * bitstring = genBitString(n);
-    if (bitstring == NULL) return NULL;
+    // Generate Sₙ packed 64 bits to a word into words[]
+    unsigned long long * words = genBitStringPacked(n);
+    if (words == NULL) return NULL;
 
 
     // Initialize the starting permutation to n, n-1, ..., 1
@@ -100,30 +346,536 @@ int * generateUniversalCycle(int n){
 
 
     // Allocate space for the universal cycle
-    int * UC = malloc((fact + 1) * sizeof(int));
+    unsigned long long length = factorial(n);
+    UCBuffer *UC = newUCBuffer(n, length, mode);
 
     // Check if memory allocation was successful
-    if (!UC || !perm) return NULL;
+    if (!UC || !perm){
+        fprintf(stderr, "Memory allocation failed\n");
+        free(words);
+        free(perm);
+        freeUCBuffer(UC);
+        return NULL;
+    }
 
-    // Walk through the bitstring and apply the σₙ/σₙ₋₁
+    // Walk through Sₙ a word at a time and apply the σₙ/σₙ₋₁
     // rotations to the starting permutation to generate
     // the universal cycle
-    for (unsigned long long i = 0; i < fact; i++){
-        UC[i] = perm[0];
-        if (bitstring[i] == '0') rotate_n(perm, n);
-        else rotate_n_minus_1(perm, n);
+    for (unsigned long long i = 0; i < length; i += 64){
+        int count = (length - i < 64) ? length - i : 64;
+        consumeWord(UC, i, words[i >> 6], count, perm, n);
     }
 
 
     // Clean up
     free(perm);
+    free(words);
+
+    return UC;
+}
+
+// Generate the next len symbols of the cycle into out with the O(1) ring,
+// running one loopless step after every symbol
+static void fillScalar(LooplessState *s, RotState *r, unsigned char *out, unsigned long long len){
+    int j;
+    for (unsigned long long i = 0; i < len; i++){
+        out[i] = r->ring[r->head];
+        rotStep(r, looplessNext(s, &j));
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// For n ≤ 16 the whole permutation fits in the byte lanes of one 128 bit
+// register and for n ≤ 20 in a 256 bit one. σₙ and σₙ₋₁ are then a single
+// byte shuffle (pshufb or vpermb) picked by the Sₙ bit, and perm[0] is 
+// pushed into a staging register that is stored once every 16 or 32 
+// symbols. The perm is handed over in bytes p[0..n-1], the unused lanes
+// are left alone by both shuffles
+
+// Build the shuffle masks, mask[1] is σₙ₋₁ and mask[0] is σₙ
+static void simdMasks(int n, unsigned char mask[2][32]){
+    for (int i = 0; i < 32; i++) mask[0][i] = mask[1][i] = i;
+    for (int i = 0; i < n; i++) mask[0][i] = (i + 1) % n;
+    for (int i = 0; i < n - 1; i++) mask[1][i] = (i + 1) % (n - 1);
+}
+
+__attribute__((target("ssse3")))
+static void fillSSSE3(LooplessState *s, unsigned char *p, unsigned char *out, unsigned long long len){
+    unsigned char m[2][32];
+    simdMasks(s->n, m);
+    __m128i mask[2] = { _mm_loadu_si128((__m128i *)m[0]), _mm_loadu_si128((__m128i *)m[1]) };
+    __m128i perm = _mm_loadu_si128((__m128i *)p);
+    __m128i stage = _mm_setzero_si128();
+
+    unsigned long long i = 0;
+    int j;
+    for (; i + 16 <= len; i += 16){
+        for (int t = 0; t < 16; t++){
+            // Shift perm[0] into the top of the staging register
+            stage = _mm_alignr_epi8(perm, stage, 1);
+            perm = _mm_shuffle_epi8(perm, mask[looplessNext(s, &j)]);
+        }
+        _mm_storeu_si128((__m128i *)(out + i), stage);
+    }
+    for (; i < len; i++){
+        out[i] = _mm_cvtsi128_si32(perm);
+        perm = _mm_shuffle_epi8(perm, mask[looplessNext(s, &j)]);
+    }
+    _mm_storeu_si128((__m128i *)p, perm);
+}
+
+__attribute__((target("avx512f,avx512vl,avx512vbmi")))
+static void fillVBMI(LooplessState *s, unsigned char *p, unsigned char *out, unsigned long long len){
+    unsigned char m[2][32], up[32];
+    simdMasks(s->n, m);
 
-    // Note:  Enabling this free results in a munmap_chunk(): 
-    // invalid pointer error.  I am not sure why this is happening
-    // as we only read from this memory in this function. The code 
-    // works fine without this free with a small memory leak caused 
-    // by the bitstring
-    free(bitstring);
+    // Index 31 picks byte 0 of the second operand (perm) and the 
+    // rest shift the staging register down by one byte
+    for (int i = 0; i < 32; i++) up[i] = i + 1;
+    __m256i shift = _mm256_loadu_si256((__m256i *)up);
+    __m256i mask[2] = { _mm256_loadu_si256((__m256i *)m[0]), _mm256_loadu_si256((__m256i *)m[1]) };
+    __m256i perm = _mm256_loadu_si256((__m256i *)p);
+    __m256i stage = _mm256_setzero_si256();
 
+    unsigned long long i = 0;
+    int j;
+    for (; i + 32 <= len; i += 32){
+        for (int t = 0; t < 32; t++){
+            stage = _mm256_permutex2var_epi8(stage, shift, perm);
+            perm = _mm256_permutexvar_epi8(mask[looplessNext(s, &j)], perm);
+        }
+        _mm256_storeu_si256((__m256i *)(out + i), stage);
+    }
+    for (; i < len; i++){
+        out[i] = _mm256_cvtsi256_si32(perm);
+        perm = _mm256_permutexvar_epi8(mask[looplessNext(s, &j)], perm);
+    }
+    _mm256_storeu_si256((__m256i *)p, perm);
+}
+#endif
+
+// Which construction kernel fillSymbols uses, picked at run time
+#define KERNEL_SCALAR 0
+#define KERNEL_SSSE3  1
+#define KERNEL_VBMI   2
+
+// Pick the fastest kernel the CPU supports for this n. Setting useSIMD
+// to 0 forces the scalar ring
+int useSIMD = 1;
+static int pickKernel(int n){
+#if defined(__x86_64__) || defined(__i386__)
+    if (!useSIMD || n < 3) return KERNEL_SCALAR;
+    if (n <= 16 && __builtin_cpu_supports("ssse3")) return KERNEL_SSSE3;
+    if (__builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512vl")) return KERNEL_VBMI;
+#endif
+    return KERNEL_SCALAR;
+}
+
+// Generate the next len symbols of the cycle into out with the given
+// kernel, running one loopless step after every symbol. The SIMD 
+// kernels take the permutation as bytes so the ring is unpacked 
+// before and packed again after
+static void fillSymbols(int kernel, LooplessState *s, RotState *r, unsigned char *out, unsigned long long len){
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel != KERNEL_SCALAR){
+        unsigned char p[32] = {0};
+        for (int i = 0; i < r->k; i++) p[i] = r->ring[r->head + i];
+        p[r->k] = r->tail;
+
+        if (kernel == KERNEL_SSSE3) fillSSSE3(s, p, out, len);
+        else fillVBMI(s, p, out, len);
+
+        r->head = 0;
+        r->tail = p[r->k];
+        for (int i = 0; i < r->k; i++) r->ring[i] = r->ring[i + r->k] = p[i];
+        return;
+    }
+#endif
+    fillScalar(s, r, out, len);
+}
+
+// Generate the shorthand universal cycle for Π(n) into a buffer in a
+// single pass. Instead of building all of Sₙ first and then walking it
+// a second time, every step of the loopless algorithm immediately 
+// drives its rotation and the symbol is written out. The only memory 
+// needed besides the output is the O(n) loopless state
+UCBuffer * generateUniversalCycleFused(int n, int mode){
+    if (n < 2) return generateUniversalCycleBuffer(n, mode);
+    if (n > maxN) return NULL;
+
+    // Allocate space for the universal cycle
+    unsigned long long length = factorial(n);
+    UCBuffer *UC = newUCBuffer(n, length, mode);
+    if (!UC){
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    LooplessState s;
+    looplessInit(&s, n);
+
+    // Initialize the starting permutation to n, n-1, ..., 1
+    RotState r;
+    rotInit(&r, n);
+
+    // Symbols are generated in cache sized blocks, straight into the 
+    // buffer when it holds bytes and through a staging block otherwise
+    int kernel = pickKernel(n);
+    unsigned char block[1 << 14];
+    for (unsigned long long i = 0; i < length; i += sizeof(block)){
+        unsigned long long len = (length - i < sizeof(block)) ? length - i : sizeof(block);
+        if (mode == UC_BYTE){
+            fillSymbols(kernel, &s, &r, (unsigned char *)UC->data + i, len);
+            continue;
+        }
+        fillSymbols(kernel, &s, &r, block, len);
+        for (unsigned long long t = 0; t < len; t++) setSymbol(UC, i + t, block[t]);
+    }
+
+    return UC;
+}
+
+// The slice of the cycle generated by one thread
+typedef struct {
+    int n;
+    UCBuffer *UC;
+    unsigned long long start;
+    unsigned long long len;
+} Slice;
+
+// Seek straight to the start of the slice and generate it
+static void * generateSlice(void *arg){
+    Slice *sl = arg;
+    LooplessState s;
+    RotState r;
+    looplessSeek(&s, sl->n, sl->start);
+    rotSeek(&r, sl->n, sl->start);
+
+    int kernel = pickKernel(sl->n);
+    unsigned char block[1 << 14];
+    unsigned long long end = sl->start + sl->len;
+    for (unsigned long long i = sl->start; i < end; i += sizeof(block)){
+        unsigned long long len = (end - i < sizeof(block)) ? end - i : sizeof(block);
+        if (sl->UC->mode == UC_BYTE){
+            fillSymbols(kernel, &s, &r, (unsigned char *)sl->UC->data + i, len);
+            continue;
+        }
+        fillSymbols(kernel, &s, &r, block, len);
+        for (unsigned long long t = 0; t < len; t++) setSymbol(sl->UC, i + t, block[t]);
+    }
+    return NULL;
+}
+
+// Generate the shorthand universal cycle for Π(n) into a buffer with the
+// given number of threads. Every thread seeks the loopless state and the
+// permutation to the start of its own slice, so the slices are generated
+// independently and the result is identical to the serial construction.
+// Slices start on multiples of 64 symbols so no two threads ever write
+// to the same word of a packed buffer
+UCBuffer * generateUniversalCycleParallel(int n, int mode, int threads){
+    if (threads <= 1 || n < 2 || n > maxN) return generateUniversalCycleFused(n, mode);
+
+    unsigned long long length = factorial(n);
+    UCBuffer *UC = newUCBuffer(n, length, mode);
+    pthread_t *tid = malloc(threads * sizeof(pthread_t));
+    Slice *slices = malloc(threads * sizeof(Slice));
+    if (!UC || !tid || !slices){
+        fprintf(stderr, "Memory allocation failed\n");
+        freeUCBuffer(UC);
+        free(tid);
+        free(slices);
+        return NULL;
+    }
+
+    unsigned long long per = ((length + threads - 1) / threads + 63) / 64 * 64;
+    int started = 0;
+    for (int t = 0; t < threads; t++){
+        unsigned long long start = t * per;
+        if (start >= length) break;
+        slices[t] = (Slice){ n, UC, start, (length - start < per) ? length - start : per };
+
+        // If we cannot get another thread just do the slice on this one
+        if (pthread_create(&tid[t], NULL, generateSlice, &slices[t]) != 0){
+            generateSlice(&slices[t]);
+            tid[t] = pthread_self();
+        }
+        started++;
+    }
+    for (int t = 0; t < started; t++) if (!pthread_equal(tid[t], pthread_self())) pthread_join(tid[t], NULL);
+
+    free(tid);
+    free(slices);
+    return UC;
+}
+
+// Generate the shorthand universal cycle for Π(n) into a buffer using
+// only the successor rule, every symbol is worked out from the n-1 before
+// it with no other state carried along. This is much slower than the 
+// loopless construction but shows that any window can be continued 
+// on its own, the result is identical to generateUniversalCycleBuffer
+UCBuffer * generateUniversalCycleSuccessor(int n, int mode){
+    if (n < 1 || n > maxN) return NULL;
+    unsigned long long length = factorial(n);
+    UCBuffer *UC = newUCBuffer(n, length, mode);
+    if (!UC){
+        fprintf(stderr, "Memory allocation failed\n");
+        return NULL;
+    }
+
+    // Start from the window of n, n-1, ..., 1 like the other constructions
+    if (n == 1){
+        setSymbol(UC, 0, 1);
+        return UC;
+    }
+    int window[maxN];
+    for (int t = 0; t < n - 1; t++){
+        window[t] = n - t;
+        setSymbol(UC, t, window[t]);
+    }
+
+    for (unsigned long long i = n - 1; i < length; i++){
+        int x = uc_successor(n, window);
+        setSymbol(UC, i, x);
+        memmove(window, window + 1, (n - 2) * sizeof(int));
+        window[n - 2] = x;
+    }
     return UC;
 }
+
+// Generate the shorthand universal cycle for Π(n) as an array of ints,
+// using the loopless σₙ/σₙ₋₁ algorithm of Ruskey–Williams
+int * generateUniversalCycle(int n){
+    UCBuffer *UC = generateUniversalCycleBuffer(n, UC_INT);
+    if (UC == NULL) return NULL;
+
+    // Hand the int array over to the caller and drop the wrapper
+    int *result = UC->data;
+    free(UC);
+    return result;
+}
+
+// A pull based generator for the universal cycle. Only the loopless 
+// state and the current permutation are kept between calls so it needs
+// O(n) memory no matter how long the cycle is
+struct UCStream {
+    int n;
+    LooplessState s;
+    RotState r;
+    int kernel;
+    unsigned long long emitted;   // symbols handed out so far
+    unsigned long long total;     // n! symbols in the whole cycle
+};
+
+// Open a generator for the shorthand universal cycle for Π(n).
+// Returns NULL if n is out of range or memory allocation failed
+UCStream * uc_open(int n){
+    if (n < 1 || n > maxN) return NULL;
+
+    UCStream *g = malloc(sizeof(UCStream));
+    if (!g) return NULL;
+
+    g->n = n;
+    g->emitted = 0;
+    g->total = factorial(n);
+    looplessInit(&g->s, n);
+
+    // Start from the permutation n, n-1, ..., 1 like generateUniversalCycle
+    rotInit(&g->r, n);
+    g->kernel = pickKernel(n);
+    return g;
+}
+
+// Open a generator that starts at symbol k of the cycle for Π(n) rather
+// than at the beginning, without generating the first k symbols
+UCStream * uc_open_at(int n, unsigned long long k){
+    UCStream *g = uc_open(n);
+    if (!g || k == 0) return g;
+    if (k >= g->total){
+        uc_close(g);
+        return NULL;
+    }
+
+    looplessSeek(&g->s, n, k);
+    rotSeek(&g->r, n, k);
+    g->emitted = k;
+    return g;
+}
+
+// Write the next (up to) len symbols of the cycle into buf. Returns the
+// number of symbols written, which is 0 once the whole cycle has been read
+unsigned long long uc_fill(UCStream *g, unsigned char *buf, unsigned long long len){
+    unsigned long long left = g->total - g->emitted;
+    if (len > left) len = left;
+
+    // Sₙ has exactly n! bits so every symbol, including the last one,
+    // is followed by a step (the last one just rotates back to the start)
+    fillSymbols(g->kernel, &g->s, &g->r, buf, len);
+
+    g->emitted += len;
+    return len;
+}
+
+// Advance the generator by the next (up to) len steps but write out the 
+// Sₙ bits that drive them, packed 64 to a word like genBitStringPacked,
+// instead of the symbols. Returns the number of bits written
+unsigned long long uc_fill_bits(UCStream *g, unsigned long long *words, unsigned long long len){
+    unsigned long long left = g->total - g->emitted;
+    if (len > left) len = left;
+
+    memset(words, 0, (len + 63) / 64 * sizeof(unsigned long long));
+    int j;
+    for (unsigned long long i = 0; i < len; i++){
+        int bit = looplessNext(&g->s, &j);
+        rotStep(&g->r, bit);
+        if (bit) words[i >> 6] |= 1ull << (i & 63);
+    }
+
+    g->emitted += len;
+    return len;
+}
+
+// Copy the permutation the generator is currently at into perm[0..n-1],
+// perm[0] is the next symbol it will hand out
+void uc_current_perm(const UCStream *g, int *perm){
+    for (int i = 0; i < g->r.k; i++) perm[i] = g->r.ring[g->r.head + i];
+    perm[g->n - 1] = g->r.tail;
+}
+
+// Rebuild len symbols of the cycle for Π(n) into out from the permutation
+// at the first of them and the Sₙ bits that follow it, replaying the 
+// σₙ/σₙ₋₁ rotations with the O(1) ring
+void expandSnBits(int n, const int *perm, const unsigned long long *words, unsigned long long len, unsigned char *out){
+    RotState r;
+    rotSet(&r, n, perm);
+    for (unsigned long long i = 0; i < len; i++){
+        out[i] = r.ring[r.head];
+        rotStep(&r, (words[i >> 6] >> (i & 63)) & 1);
+    }
+}
+
+void uc_close(UCStream *g){
+    free(g);
+}
+
+// Return the symbol at index i of the cycle for Π(n) without generating
+// any of the cycle. Symbol i is the first element of the permutation with
+// Ruskey–Williams rank i, so this is one O(n²) unranking. Returns -1 if
+// n or i is out of range
+int uc_symbol_at(int n, unsigned long long i){
+    if (n < 1 || n > maxN || i >= factorial(n)) return -1;
+
+    int perm[maxN];
+    unrankRuskeyWilliams(i, n, perm);
+    return perm[0];
+}
+
+// Return the index in the cycle for Π(n) where the window of perm starts,
+// only perm[0..n-2] are read and the last symbol is taken to be the 
+// missing one. This is the Ruskey–Williams rank of the permutation 
+// (the inverse of uc_symbol_at's unranking), worked out in O(n) in 64
+// bits so it covers all n up to maxN. Returns -1 if the window is not 
+// n-1 distinct symbols of 1..n
+unsigned long long uc_position_of(int n, const int *perm){
+    if (n < 1 || n > maxN) return -1;
+
+    int cur[maxN], sum = n * (n + 1) / 2;
+    for (int i = 0; i < n - 1; i++){
+        cur[i] = perm[i];
+        sum -= perm[i];
+    }
+    cur[n - 1] = sum;
+    return rankRuskeyWilliamsFast(cur, n);
+}
+
+// The successor rule for the cycle for Π(n): given the last n-1 symbols
+// in window return the symbol that follows them, using nothing but the
+// window. The window's position i is its rank and bit i of Sₙ says which
+// rotation comes next. A σₙ₋₁ brings window[0] back around while a σₙ 
+// appends the symbol missing from the window. Returns -1 if the window
+// is not n-1 distinct symbols of 1..n
+int uc_successor(int n, const int *window){
+    unsigned long long i = uc_position_of(n, window);
+    if (i == -1ull) return -1;
+
+    int missing = n * (n + 1) / 2;
+    for (int t = 0; t < n - 1; t++) missing -= window[t];
+    if (n < 3) return missing;
+    return looplessBitAt(n, i) ? window[0] : missing;
+}
+
+// Write the symbols at indices i..j-1 of the cycle for Π(n) into buf. 
+// The loopless state and the permutation at i are computed directly from
+// i so only the requested range is generated. Returns the number of 
+// symbols written, j is clamped to n!
+unsigned long long uc_range(int n, unsigned long long i, unsigned long long j, unsigned char *buf){
+    if (n < 1 || n > maxN) return 0;
+    if (j > factorial(n)) j = factorial(n);
+    if (i >= j) return 0;
+
+    UCStream *g = uc_open_at(n, i);
+    if (!g) return 0;
+    unsigned long long got = uc_fill(g, buf, j - i);
+    uc_close(g);
+    return got;
+}
+
+// Return the wall clock time in seconds
+double now(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Compare the speed of the original rotations, which shift the whole
+// permutation for every symbol, against the O(1) ring and against the
+// kernel picked for uc_fill (SIMD when the CPU has it). For each n from
+// lo to hi the first min(n!, cap) symbols are generated every way and 
+// the throughput in symbols/sec is printed to fptr
+void benchmarkConstruction(int lo, int hi, unsigned long long cap, FILE *fptr){
+    static const char *names[] = { "scalar", "ssse3", "vbmi" };
+    unsigned char buf[1 << 16], ref[1 << 16];
+    fprintf(fptr, "%3s %12s %14s %14s %14s %8s\n", "n", "symbols",
+            "shift sym/s", "ring sym/s", "kernel sym/s", "kernel");
+
+    for (int n = lo; n <= hi && n <= maxN; n++){
+        unsigned long long count = factorial(n);
+        if (count > cap) count = cap;
+        double rate[3];
+
+        for (int method = 0; method < 3; method++){
+            double start = now();
+            LooplessState s;
+            looplessInit(&s, n);
+            RotState r;
+            rotInit(&r, n);
+            int perm[maxN], j;
+            for (int i = 0; i < n; i++) perm[i] = n - i;
+            int kernel = method == 2 ? pickKernel(n) : KERNEL_SCALAR;
+
+            for (unsigned long long done = 0; done < count; ){
+                unsigned long long len = count - done < sizeof(buf) ? count - done : sizeof(buf);
+                if (method == 0){
+                    // The original shifting rotations
+                    for (unsigned long long i = 0; i < len; i++){
+                        buf[i] = perm[0];
+                        if (looplessNext(&s, &j)) rotate_n_minus_1(perm, n);
+                        else rotate_n(perm, n);
+                    }
+                }
+                else fillSymbols(kernel, &s, &r, buf, len);
+                done += len;
+            }
+            rate[method] = count / (now() - start);
+
+            // Every method has to end on the same block of symbols
+            if (method == 0) memcpy(ref, buf, sizeof(buf));
+            else if (memcmp(ref, buf, sizeof(buf)) != 0)
+                fprintf(stderr, "Warning: n = %d method %d disagrees\n", n, method);
+        }
+
+        fprintf(fptr, "%3d %12llu %14.0f %14.0f %14.0f %8s\n", n, count,
+                rate[0], rate[1], rate[2], names[pickKernel(n)]);
+    }
+}
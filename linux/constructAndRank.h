@@ -1,24 +1,187 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+
+// The max value of n we could have. This is because we are storing 
+// n! in a unsigned long long which enables us to go up to 20! which 
+// is more than enough as we will hit memory limits before we hit this limit
+#define maxN 20
 
 extern unsigned long long fact;
+extern int useSIMD;
+
+// Storage modes for the symbols of a universal cycle. Every symbol
+// is at most 20 so an int per symbol wastes most of the memory, which
+// is what stops us from building the larger cycles (n = 13 as ints is
+// about 25 GB, as bytes about 6 GB and packed about 3-4 GB)
+#define UC_INT    0   // one int per symbol (the original layout)
+#define UC_BYTE   1   // one byte per symbol
+#define UC_PACKED 2   // 4 bits per symbol for n <= 15, 5 bits for n <= 20
+
+typedef struct {
+    int mode;                 // UC_INT, UC_BYTE or UC_PACKED
+    int bits;                 // bits per symbol when mode is UC_PACKED
+    unsigned long long len;   // number of symbols stored
+    void *data;
+} UCBuffer;
+
+// Read the symbol at index i of a universal cycle buffer. Packed symbols
+// are stored little end first and may straddle two 64 bit words, so one
+// spare word is always allocated at the end of the packed array
+static inline int getSymbol(const UCBuffer *uc, unsigned long long i){
+    if (uc->mode == UC_BYTE) return ((unsigned char *)uc->data)[i];
+    if (uc->mode == UC_INT) return ((int *)uc->data)[i];
+
+    const unsigned long long *w = uc->data;
+    unsigned long long bit = i * uc->bits;
+    unsigned int off = bit & 63;
+    unsigned long long v = w[bit >> 6] >> off;
+    if (off + uc->bits > 64) v |= w[(bit >> 6) + 1] << (64 - off);
+    return v & ((1u << uc->bits) - 1);
+}
+
+// Write the symbol x at index i of a universal cycle buffer
+static inline void setSymbol(UCBuffer *uc, unsigned long long i, int x){
+    if (uc->mode == UC_BYTE){ ((unsigned char *)uc->data)[i] = x; return; }
+    if (uc->mode == UC_INT){ ((int *)uc->data)[i] = x; return; }
+
+    unsigned long long *w = uc->data;
+    unsigned long long mask = (1ull << uc->bits) - 1;
+    unsigned long long bit = i * uc->bits;
+    unsigned int off = bit & 63;
+    w[bit >> 6] = (w[bit >> 6] & ~(mask << off)) | ((unsigned long long)x << off);
+    if (off + uc->bits > 64){
+        unsigned int spill = 64 - off;
+        w[(bit >> 6) + 1] = (w[(bit >> 6) + 1] & ~(mask >> spill)) | ((unsigned long long)x >> spill);
+    }
+}
+
+// Universal cycle buffer functions
+UCBuffer * newUCBuffer(int n, unsigned long long len, int mode);
+void freeUCBuffer(UCBuffer *uc);
 
 // Construction functions
 char * genBitString(int n);
+unsigned long long * genBitStringPacked(int n);
 int * generateUniversalCycle(int n);
+UCBuffer * generateUniversalCycleBuffer(int n, int mode);
+UCBuffer * generateUniversalCycleFused(int n, int mode);
+
+// Streaming construction, the cycle is handed out in chunks through a
+// caller provided buffer without ever being held in memory as a whole
+typedef struct UCStream UCStream;
+UCStream * uc_open(int n);
+unsigned long long uc_fill(UCStream *g, unsigned char *buf, unsigned long long len);
+UCStream * uc_open_at(int n, unsigned long long k);
+unsigned long long uc_fill_bits(UCStream *g, unsigned long long *words, unsigned long long len);
+void uc_current_perm(const UCStream *g, int *perm);
+void expandSnBits(int n, const int *perm, const unsigned long long *words, unsigned long long len, unsigned char *out);
+void uc_close(UCStream *g);
+int uc_symbol_at(int n, unsigned long long i);
+unsigned long long uc_position_of(int n, const int *perm);
+int uc_successor(int n, const int *window);
+unsigned long long uc_range(int n, unsigned long long i, unsigned long long j, unsigned char *buf);
+UCBuffer * generateUniversalCycleParallel(int n, int mode, int threads);
+UCBuffer * generateUniversalCycleSuccessor(int n, int mode);
+
+// 7-order construction with the Bell7 algorithm, either recursively into
+// an array or iteratively through the same chunked interface as uc_fill.
+// Only a universal cycle for n ≤ 4, see generateBell7Cycle
+int * generateBell7Cycle(int n);
+typedef struct Bell7Stream Bell7Stream;
+Bell7Stream * bell7_open(int n);
+unsigned long long bell7_fill(Bell7Stream *g, unsigned char *buf, unsigned long long len);
+void bell7_close(Bell7Stream *g);
+UCBuffer * generateBell7Parallel(int n, int mode, int depth, int threads);
+void benchmarkConstruction(int lo, int hi, unsigned long long cap, FILE *fptr);
+
+// Output and verification functions
+void outputUC(int *UC, int n, FILE *fptr);
+void outputUCBuffer(const UCBuffer *uc, int n, FILE *fptr);
+void streamUC(int n, int sevenOrder, FILE *fptr);
+void encodeSymbols(unsigned char *buf, unsigned long long len);
+int writeUCMapped(int n, const char *path, int threads);
+
+// Binary container for universal cycles, a header saying what is inside
+// followed by the packed symbols in chunks that each carry a CRC32C
+#define UCF_RUSKEY_WILLIAMS 0
+#define UCF_BELL7           1
+#define UCF_SYMBOLS         0
+#define UCF_SN_BITS         1
+
+typedef struct UCFile UCFile;
+unsigned int crc32c(unsigned int crc, const void *buf, size_t len);
+int ucfile_write(const char *path, int n, int algo);
+int ucfile_write_sn(const char *path, int n);
+UCFile * ucfile_open(const char *path);
+void ucfile_close(UCFile *f);
+int ucfile_n(const UCFile *f);
+int ucfile_algo(const UCFile *f);
+int ucfile_payload(const UCFile *f);
+unsigned long long ucfile_length(const UCFile *f);
+unsigned long long ucfile_chunks(const UCFile *f);
+int ucfile_check_chunk(const UCFile *f, unsigned long long c);
+int ucfile_symbol(const UCFile *f, unsigned long long i);
+unsigned long long ucfile_read(const UCFile *f, unsigned long long start, unsigned char *buf, unsigned long long len);
+UCBuffer * ucfile_buffer(const UCFile *f);
+typedef struct UCFileStream UCFileStream;
+int ucfile_is_container(const unsigned char *prefix, size_t prefixLen);
+int ucfile_header_n(const unsigned char *prefix, size_t prefixLen);
+UCFileStream * ucfile_stream_open(FILE *fptr, const unsigned char *prefix, size_t prefixLen);
+int ucfile_stream_n(const UCFileStream *s);
+unsigned long long ucfile_stream_length(const UCFileStream *s);
+unsigned long long ucfile_stream_read(UCFileStream *s, unsigned char *buf, unsigned long long len);
+unsigned long long ucfile_stream_bytes(const UCFileStream *s);
+int ucfile_stream_failed(const UCFileStream *s);
+void ucfile_stream_close(UCFileStream *s);
+int isUniversalCycle(int *U, unsigned long long L, int n);
+int isUniversalCycleBuffer(const UCBuffer *uc, int n);
+int isUniversalCycleSliding(const UCBuffer *uc, int n);
+int isUniversalCycleParallel(const UCBuffer *uc, int n, int threads);
+int isUniversalCyclePartitioned(const UCBuffer *uc, int n, int threads);
+void benchmarkVerification(int lo, int hi, int threads, FILE *fptr);
+int verifyUCFile(const char *path, int n, int threads);
+typedef struct UCVerifier UCVerifier;
+UCVerifier * ucv_open(int n);
+UCVerifier * ucv_open_range(int n, unsigned long long lo, unsigned long long hi);
+int ucv_feed(UCVerifier *uv, const unsigned char *sym, unsigned long long len);
+int ucv_finish(UCVerifier *uv);
+void ucv_close(UCVerifier *uv);
+int verifyStream(FILE *fptr, int n);
+int verifyStreamBudget(FILE *fptr, int n, unsigned long long budget, FILE *report);
+int verifyShardScan(const char *path, int n, int shards, int k, const char *dir);
+int verifyShardMerge(int n, int shards, int k, const char *dir);
+int verifyShardsMerged(int n, int shards, const char *dir);
+int verifySharded(const char *path, int n, int shards, const char *dir, FILE *report);
 
 // Ranking function
+#define RANK_7ORDER          0
+#define RANK_RUSKEY_WILLIAMS 1
+#define RANK_LEHMER          2
 int rankLehmer(int *U, int L, int n, int start);
+long long rankLehmerBuffer(const UCBuffer *uc, int n, unsigned long long start);
+long long rankLehmerFast(const int *perm, int n);
+void rank7OrderBatch(const uint8_t *perms, size_t count, int n, uint64_t *ranks);
+void rankLehmerBatch(const uint8_t *perms, size_t count, int n, uint64_t *ranks);
+void rankRuskeyWilliamsBatch(const uint8_t *perms, size_t count, int n, uint64_t *ranks);
 int rank7Order(int *perm, int n);
 int rankRuskeyWilliams(int *p, int n);
+int rank7OrderDigits(const int *perm, int n, int *offset);
+long long rank7OrderFast(const int *perm, int n);
+long long rankRuskeyWilliamsFast(const int *perm, int n);
+int unrankRuskeyWilliams(unsigned long long rank, int n, int *perm);
+int unrank7Order(unsigned long long rank, int n, int *perm);
+int unrankLehmer(unsigned long long rank, int n, int *perm);
+int unrankBatch(int order, const unsigned long long *ranks, unsigned long long count, int n, int *perms);
 
 // Helper functions
 unsigned long long factorial(unsigned int n);
+double now(void);
 void rotate_n(int *p, int n);
 void rotate_n_minus_1(int *p, int n);
-void visit(int *perm, int n, int *sp_cycle, int *count);
 void shift(int *a, int i, int j);
-void bell7(int *perm, int n, int m, int *sp_cycle, int *count);
 int is_duplicate(int *cycle, int pos, int len, int n);
 
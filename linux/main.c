@@ -1,131 +1,670 @@
 #include "constructAndRank.h"
 
-unsigned long long fact;
-
-// Helper function to compute n!
-// By storing n! as an unsigned long long we can compute
-// and store values of n factorial that are less than or equal 
-// to 20. This is more than enough for our purposes as to store 
-// the bitstring for n = 20 we would need 20! = 2,432,902,008,176,640,000 
-// bytes which is 2.4 exabytes, far more than any current computer 
-// can store in memory 
-unsigned long long factorial(unsigned int n){
-  unsigned long f = 1;
-  for (unsigned int i = 2; i <= n; i++) f *= i;
-  return f;
-}
-
-// Return 1 if U[0..] of length n! is a valid shorthand U‑cycle for Π(n), 0 otherwise
-int isUniversalCycle(int *U, unsigned long long L, int n){
-  unsigned long long len = factorial(n);
-  // If the length of U is not equal to n! then it cannot be a universal cycle
-  if (len != L) return 0;
-  //printf("L = %llu, n! = %llu, n = %d\n", L, len,n);
-
-  // To keep track of which ranks we've seen
-  char *seen = malloc(L * sizeof(char));
-  if (!seen) {
-      fprintf(stderr, "Error memory allocation failed\n");
+void outputUC(int * UC, int n, FILE *fptr){
+  UCBuffer uc = { UC_INT, 0, fact, UC };
+  outputUCBuffer(&uc, n, fptr);
+}
+
+void outputUCBuffer(const UCBuffer *UC, int n, FILE *fptr){
+  // If n is less then 10 output the UC as normal to the desired output stream
+  if (n < 10) for (unsigned long long i = 0; i < UC->len; i++) fprintf(fptr,"%d", getSymbol(UC, i));
+
+  // If n is greater than or equal to 10 we will have conflicts with overlaping numbers
+  // (ie '1112' could be '1,11,2' or '11,12') and there won't be a good way to distinguish  
+  // between these all of the different possibilities. So as a solution to this problem we    
+  // will output the UC as a string of characters, where 0-9 are represented by '0'-'9' 
+  // and 10-n are represented by A,B,C... This way we can represent all numbers from 0 
+  // to n without any ambiguity. 
+  else{
+    for (unsigned long long i = 0; i < UC->len; i++){
+      int x = getSymbol(UC, i);
+      if (x < 10) fprintf(fptr,"%d", x);
+      else fprintf(fptr,"%c",x-10+'A');
+    }
+  }
+}
+
+// Output the UC for Π(n) to fptr by pulling it out of the streaming 
+// generator one chunk at a time, so the cycle is never held in memory
+// and the first symbols are written straight away. If sevenOrder is set
+// the 7-order cycle from Bell7 is output instead of the Ruskey–Williams
+// one. Uses the same characters as outputUC ('0'-'9' and then A,B,C... 
+// from 10 onwards)
+void streamUC(int n, int sevenOrder, FILE *fptr){
+  UCStream *g = NULL;
+  Bell7Stream *b = NULL;
+  if (sevenOrder) b = bell7_open(n);
+  else g = uc_open(n);
+  if (g == NULL && b == NULL){
+    fprintf(stderr, "Error opening the universal cycle generator\n");
+    return;
+  }
+
+  unsigned char buf[1 << 16];
+  unsigned long long got;
+  while ((got = (b ? bell7_fill(b, buf, sizeof(buf)) : uc_fill(g, buf, sizeof(buf)))) > 0){
+    encodeSymbols(buf, got);
+    fwrite(buf, 1, got, fptr);
+  }
+
+  if (b) bell7_close(b);
+  else uc_close(g);
+}
+
+// Return 1 if the flag was given anywhere on the command line
+static int hasFlag(int argc, char **argv, const char *flag){
+  for (int i = 1; i < argc; i++) if (strcmp(argv[i], flag) == 0) return 1;
+  return 0;
+}
+
+// Return the value given after the flag, or NULL if the flag was not given
+static char * flagValue(int argc, char **argv, const char *flag){
+  for (int i = 1; i < argc - 1; i++) if (strcmp(argv[i], flag) == 0) return argv[i + 1];
+  return NULL;
+}
+
+// Generate the UC for Π(n) the way the command line asks for and output
+// it to the file "UC" or to stdout. Returns 0 if it could not be generated
+static int outputCycle(int n, int threads, int argc, char **argv){
+  // if the user entered '-f' to have the UC outputed to a file
+  // then open the output file, otherwise output the UC to stdout
+  FILE *fptr = stdout;
+  if (hasFlag(argc, argv, "-f")) fptr = fopen("UC", "w");
+  else printf("UC: ");
+
+  // '-s' streams the UC straight from the generator to the output
+  // without building it in memory first, '-7' streams the 7-order 
+  // cycle from Bell7 the same way (only a universal cycle for n ≤ 4)
+  if (hasFlag(argc, argv, "-s") || (hasFlag(argc, argv, "-7") && threads == 0)) streamUC(n, hasFlag(argc, argv, "-7"), fptr);
+  else{
+    // '-b' stores the UC with one byte per symbol and '-p' bit packs it 
+    // (4 or 5 bits per symbol), otherwise we use one int per symbol
+    int mode = UC_INT;
+    if (hasFlag(argc, argv, "-b")) mode = UC_BYTE;
+    if (hasFlag(argc, argv, "-p")) mode = UC_PACKED;
+
+    // '-u' builds the UC in a single fused pass without Sₙ and 
+    // '-t <threads>' splits that pass across several threads, 
+    // '-r' builds it symbol by symbol from the successor rule
+    // '-7 -t <threads>' builds the 7-order cycle with a pool of threads,
+    // splitting the recursion at the depth given by '-d <depth>'
+    UCBuffer *UC;
+    char *depth = flagValue(argc, argv, "-d");
+    if (hasFlag(argc, argv, "-7")) UC = generateBell7Parallel(n, mode, depth ? atoi(depth) : 0, threads);
+    else if (threads) UC = generateUniversalCycleParallel(n, mode, threads);
+    else if (hasFlag(argc, argv, "-u")) UC = generateUniversalCycleFused(n, mode);
+    else if (hasFlag(argc, argv, "-r")) UC = generateUniversalCycleSuccessor(n, mode);
+    else UC = generateUniversalCycleBuffer(n, mode);
+    if (UC == NULL){
+      printf("Error generating universal cycle\n");
       return 0;
+    }
+    outputUCBuffer(UC, n, fptr);
+    freeUCBuffer(UC);
+  }
+
+  if (fptr == stdout) printf("\n");
+  else fclose(fptr);
+  return 1;
+}
+
+// Check the container at path and print what is in it. Returns the
+// exit status for main, 0 if it holds a valid universal cycle
+static int checkContainer(const char *path){
+  UCFile *f = ucfile_open(path);
+  if (!f) return 1;
+
+  int n = ucfile_n(f), ok = 1;
+  printf("%s: n=%d algo=%s payload=%s length=%llu chunks=%llu\n", path, n,
+         ucfile_algo(f) == UCF_BELL7 ? "bell7" : "ruskey-williams",
+         ucfile_payload(f) == UCF_SN_BITS ? "sn-bits" : "symbols", ucfile_length(f), ucfile_chunks(f));
+
+  for (unsigned long long c = 0; c < ucfile_chunks(f); c++){
+    if (!ucfile_check_chunk(f, c)){
+      printf("chunk %llu fails its checksum\n", c);
+      ok = 0;
+    }
   }
-  memset(seen, 0, L * sizeof(char));
-
-  // Can be used to select the ranking algorithm
-  // 2 for 7-order, 1 for Lehmer code, 0 for Ruskey-Williams
-  int algo = 2;
-
-  // Loop through the universal cycle U and compute the rank of each
-  // substring of length n-1 starting at index i
-  // If the rank is invalid or we have seen this rank before
-  // then the given string is not a universal cycle
-  for (unsigned long long i = 0; i < L; i++) {
-    // Call a ranking function
-    int rank;
-    if (algo == 2){
-      // If we are using the 7-order ranking algorithm then we need to
-      // create a permutation of length n before we call the ranking 
-      // algorithm. This means that we will have to find the missing 
-      // symbol in the current substring of of length n-1 and append it
-      // to the end of the substring to create a full permutation of length n
-
-      // Copy the current substring of length n-1 into a permutation
-      // and compute the sum of the symbols in the substring
-      int perm[n], sum = 0;
-      for (int j = 0; j < n-1; j++){ 
-        perm[j] = U[(i+j) % L];
-        sum += perm[j];
+
+  // An archive has no symbols to view in place, and neither do chunks 
+  // that are not laid end to end, so read those into a buffer first
+  UCBuffer *uc = ok ? ucfile_buffer(f) : NULL, *expanded = NULL;
+  if (ok && !uc){
+    expanded = newUCBuffer(n, ucfile_length(f), UC_BYTE);
+    ok = expanded && ucfile_read(f, 0, expanded->data, expanded->len) == expanded->len;
+  }
+  if (ok){
+    fact = factorial(n);
+    ok = isUniversalCycleBuffer(uc ? uc : expanded, n);
+  }
+  printf("%s\n", ok ? "YES" : "no");
+
+  free(uc);
+  freeUCBuffer(expanded);
+  ucfile_close(f);
+  return !ok;
+}
+
+// Self-test: the parallel construction (every thread seeks the loopless
+// state to its slice), the fused construction on the SIMD and scalar 
+// kernels, the successor rule and the streaming generator opened part
+// way in all have to give exactly the cycle the serial construction 
+// from Sₙ gives, and uc_position_of has to put every window back where
+// it starts. Returns the number of failures
+static int testConstruction(int lo, int hi){
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    fact = factorial(n);
+    UCBuffer *serial = generateUniversalCycleBuffer(n, UC_BYTE);
+    if (!serial) return failed + 1;
+    const unsigned char *want = serial->data;
+
+    UCBuffer *built[5];
+    built[0] = generateUniversalCycleParallel(n, UC_BYTE, 3);
+    built[1] = generateUniversalCycleParallel(n, UC_BYTE, 7);
+    int simd = useSIMD;
+    useSIMD = 1;
+    built[2] = generateUniversalCycleFused(n, UC_BYTE);
+    useSIMD = 0;
+    built[3] = generateUniversalCycleFused(n, UC_BYTE);
+    useSIMD = simd;
+    built[4] = generateUniversalCycleSuccessor(n, UC_BYTE);
+
+    int ok = 1;
+    for (int b = 0; b < 5; b++){
+      ok &= built[b] && built[b]->len == fact && memcmp(built[b]->data, want, fact) == 0;
+      freeUCBuffer(built[b]);
+    }
+
+    // Open the stream part way in at a few places and compare what follows
+    unsigned long long starts[] = { 1, fact / 3, fact / 2 + 1, fact - 1 };
+    for (int t = 0; t < 4 && starts[t] < fact; t++){
+      unsigned char buf[4096];
+      UCStream *g = uc_open_at(n, starts[t]);
+      unsigned long long got = g ? uc_fill(g, buf, sizeof(buf)) : 0;
+      ok &= got == (fact - starts[t] < sizeof(buf) ? fact - starts[t] : sizeof(buf));
+      ok &= memcmp(buf, want + starts[t], got) == 0;
+      ok &= uc_symbol_at(n, starts[t]) == want[starts[t]];
+      if (g) uc_close(g);
+    }
+
+    // A window of repeated symbols has no position
+    for (unsigned long long i = 0; i < fact; i++){
+      int perm[maxN];
+      for (int j = 0; j < n - 1; j++) perm[j] = want[(i + j) % fact];
+      ok &= uc_position_of(n, perm) == i;
+    }
+    int repeated[maxN] = { 1, 1 };
+    ok &= n < 3 || uc_position_of(n, repeated) == -1ull;
+
+    printf("construction n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+    freeUCBuffer(serial);
+  }
+  return failed;
+}
+
+// Self-test: past n = 16 the stream uses the AVX-512 VBMI kernel when the
+// CPU has it, and the cycles are far too long to build whole. So open 
+// the stream part way in with the SIMD kernel and with the scalar one 
+// and compare a block of what follows, checking the spot checks against
+// uc_symbol_at. Returns the number of failures
+static int testKernels(int lo, int hi){
+  unsigned long long block = 100003;
+  unsigned char *got[2] = { malloc(block), malloc(block) };
+  if (!got[0] || !got[1]){
+    free(got[0]);
+    free(got[1]);
+    return 1;
+  }
+
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    unsigned long long L = factorial(n);
+    unsigned long long starts[] = { 1, L / 3, L / 2 + 12345, L - block };
+    int ok = 1;
+    for (int t = 0; t < 4; t++){
+      unsigned long long len[2] = { 0, 0 };
+      int simd = useSIMD;
+      for (int k = 0; k < 2; k++){
+        useSIMD = 1 - k;
+        UCStream *g = uc_open_at(n, starts[t]);
+        if (g) len[k] = uc_fill(g, got[k], block);
+        if (g) uc_close(g);
       }
-      // Find the missing symbol 1..n in the permutation using 
-      // the fact that ∑n = n(n+1)/2 and ∑perm = ∑n - missing
-      // So missing = ∑n - ∑perm
-      int missing = (n * (n + 1) / 2) - sum;
-      perm[n-1] = missing;
-
-      // Now that we have constructed the full permutation we can compute its rank
-      rank = rank7Order(perm, n);
-      
-    }
-
-    else if (algo == 1) rank = rankLehmer(U, L, n, i);
-    else{
-      // If we are using the Ruskey-Williams algorithm then we need to
-      // create a permutation of length n before we call the ranking 
-      // algorithm. This means that we will have to find the missing 
-      // symbol in the current substring of of length n-1 and append it
-      // to the end of the substring to create a full permutation of length n
-
-      // Copy the current substring of length n-1 into a permutation
-      // and compute the sum of the symbols in the substring
-      int perm[n], sum = 0;
-      for (int j = 0; j < n-1; j++){ 
-        perm[j] = U[(i+j) % L];
-        sum += perm[j];
+      useSIMD = simd;
+
+      ok &= len[0] == block && len[1] == block && memcmp(got[0], got[1], block) == 0;
+      ok &= uc_symbol_at(n, starts[t]) == got[0][0];
+      ok &= uc_symbol_at(n, starts[t] + block - 1) == got[0][block - 1];
+    }
+
+    printf("kernels n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+  }
+  free(got[0]);
+  free(got[1]);
+  return failed;
+}
+
+// Self-test: the iterative Bell7 stream, filled in uneven pieces, and
+// the parallel Bell7 (at every depth, on 1 and 4 threads and in every
+// buffer mode) have to give exactly the symbols the recursive Bell7 
+// gives. Returns the number of failures
+static int testBell7(int lo, int hi){
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    unsigned long long len = factorial(n);
+    int *want = generateBell7Cycle(n);
+    unsigned char *got = malloc(len);
+    Bell7Stream *g = bell7_open(n);
+    if (!want || !got || !g){
+      free(want);
+      free(got);
+      if (g) bell7_close(g);
+      return failed + 1;
+    }
+
+    unsigned long long filled = 0, piece = 1;
+    while (filled < len){
+      unsigned long long ask = len - filled < piece ? len - filled : piece;
+      unsigned long long step = bell7_fill(g, got + filled, ask);
+      if (step == 0) break;
+      filled += step;
+      piece = piece * 3 + 1;
+    }
+
+    int ok = filled == len && bell7_fill(g, got, 1) == 0;
+    for (unsigned long long i = 0; ok && i < len; i++) ok = got[i] == want[i];
+
+    // Packed buffers drop to a smaller depth on their own when the 
+    // subtrees would share a word
+    int threads[] = { 1, 4 };
+    for (int mode = UC_INT; mode <= UC_PACKED; mode++){
+      for (int depth = 0; depth <= n - 1; depth++){
+        for (int t = 0; t < 2; t++){
+          UCBuffer *uc = generateBell7Parallel(n, mode, depth, threads[t]);
+          ok &= uc && uc->len == len;
+          for (unsigned long long i = 0; ok && i < len; i++) ok = getSymbol(uc, i) == want[i];
+          freeUCBuffer(uc);
+        }
+      }
+    }
+
+    printf("bell7 n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+    bell7_close(g);
+    free(want);
+    free(got);
+  }
+  return failed;
+}
+
+// Self-test: a container written with ucfile_write has to read back as
+// the serial Ruskey–Williams cycle with every chunk checksum matching,
+// and flipping a byte of its payload has to break the last chunk's
+// checksum. An Sₙ archive has to give the same symbols when it is read
+// from part way into a chunk. Uses the scratch file selftest.ucf. 
+// Returns the number of failures
+static int testContainer(int lo, int hi){
+  const char *path = "selftest.ucf";
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    UCBuffer *serial = generateUniversalCycleBuffer(n, UC_BYTE);
+    unsigned char *got = serial ? malloc(serial->len) : NULL;
+    if (!got){
+      freeUCBuffer(serial);
+      return failed + 1;
+    }
+
+    int ok = ucfile_write(path, n, UCF_RUSKEY_WILLIAMS);
+    UCFile *f = ok ? ucfile_open(path) : NULL;
+    ok = f != NULL;
+    if (f){
+      ok &= ucfile_n(f) == n && ucfile_length(f) == serial->len;
+      for (unsigned long long c = 0; c < ucfile_chunks(f); c++) ok &= ucfile_check_chunk(f, c);
+      ok &= ucfile_read(f, 0, got, serial->len) == serial->len;
+      ok &= memcmp(got, serial->data, serial->len) == 0;
+      ok &= ucfile_symbol(f, serial->len - 1) == ((unsigned char *)serial->data)[serial->len - 1];
+      ucfile_close(f);
+    }
+
+    // The payload is at the end of the file
+    FILE *fptr = fopen(path, "r+b");
+    int byte = fptr && fseek(fptr, -1, SEEK_END) == 0 ? fgetc(fptr) : EOF;
+    ok &= byte != EOF && fseek(fptr, -1, SEEK_END) == 0 && fputc(byte ^ 0x10, fptr) != EOF;
+    if (fptr) fclose(fptr);
+    f = ucfile_open(path);
+    ok &= f && !ucfile_check_chunk(f, ucfile_chunks(f) - 1);
+    if (f) ucfile_close(f);
+
+    // Start reading the Sₙ archive at a few places that are not on a 
+    // chunk boundary, so the chunk is replayed from its checkpoint
+    const unsigned char *want = serial->data;
+    unsigned long long L = serial->len;
+    ok &= ucfile_write_sn(path, n);
+    f = ucfile_open(path);
+    ok &= f && ucfile_payload(f) == UCF_SN_BITS && ucfile_length(f) == L;
+    unsigned long long starts[] = { 0, 1, L / 3, L / 2 + 1, L - 1 };
+    for (int t = 0; f && t < 5 && starts[t] < L; t++){
+      unsigned long long len = L - starts[t] < 5000 ? L - starts[t] : 5000;
+      ok &= ucfile_read(f, starts[t], got, len) == len && memcmp(got, want + starts[t], len) == 0;
+      ok &= ucfile_symbol(f, starts[t]) == want[starts[t]];
+    }
+    ok &= f && ucfile_read(f, 0, got, L) == L && memcmp(got, want, L) == 0;
+    if (f) ucfile_close(f);
+
+    printf("container n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+    free(got);
+    freeUCBuffer(serial);
+  }
+  remove(path);
+  return failed;
+}
+
+// Self-test: for every permutation of n the O(n) ranks have to match the
+// recursive ones, and the batch ranks (on the SIMD and scalar paths) the
+// O(n) ones. Unranking every rank in each order, one at a time and in a
+// batch, has to give a permutation with that rank back, and a rank past
+// n!-1 has to be refused. Returns the number of failures
+static int testRanks(int lo, int hi){
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    size_t count = factorial(n);
+    uint8_t *perms = malloc(count * n);
+    uint64_t *want[3], *got = malloc(count * sizeof(uint64_t));
+    for (int o = 0; o < 3; o++) want[o] = malloc(count * sizeof(uint64_t));
+    if (!perms || !got || !want[0] || !want[1] || !want[2]) return failed + 1;
+
+    int ok = 1;
+    for (size_t k = 0; k < count; k++){
+      int perm[maxN];
+      unrank7Order(k, n, perm);
+      ok &= rank7OrderFast(perm, n) == rank7Order(perm, n);
+      ok &= rankRuskeyWilliamsFast(perm, n) == rankRuskeyWilliams(perm, n);
+      ok &= rankLehmerFast(perm, n) == rankLehmer(perm, n, n, 0);
+
+      want[0][k] = rank7OrderFast(perm, n);
+      want[1][k] = rankRuskeyWilliamsFast(perm, n);
+      want[2][k] = rankLehmerFast(perm, n);
+      for (int i = 0; i < n; i++) perms[i * count + k] = perm[i];
+
+      int back[3][maxN];
+      ok &= unrank7Order(k, n, back[0]) && unrankRuskeyWilliams(k, n, back[1]) && unrankLehmer(k, n, back[2]);
+      ok &= rank7OrderFast(back[0], n) == (long long)k && rankRuskeyWilliamsFast(back[1], n) == (long long)k;
+      ok &= rankLehmerFast(back[2], n) == (long long)k;
+    }
+
+    // The batch unrank has to match the single one
+    int order[3] = { RANK_7ORDER, RANK_RUSKEY_WILLIAMS, RANK_LEHMER };
+    int (*unrank[3])(unsigned long long, int, int *) = { unrank7Order, unrankRuskeyWilliams, unrankLehmer };
+    unsigned long long *ranks = malloc(count * sizeof(unsigned long long));
+    int *batched = malloc(count * n * sizeof(int));
+    for (size_t k = 0; ranks && k < count; k++) ranks[k] = k;
+    for (int o = 0; ranks && batched && o < 3; o++){
+      ok &= unrankBatch(order[o], ranks, count, n, batched);
+      for (size_t k = 0; k < count; k++){
+        int perm[maxN];
+        unrank[o](k, n, perm);
+        ok &= memcmp(perm, batched + k * n, n * sizeof(int)) == 0;
       }
-      // Find the missing symbol 1..n in the permutation using 
-      // the fact that ∑n = n(n+1)/2 and ∑perm = ∑n - missing
-      // So missing = ∑n - ∑perm
-      int missing = (n * (n + 1) / 2) - sum;
-      perm[n-1] = missing;
+      int perm[maxN];
+      ok &= !unrank[o](count, n, perm);
+      ranks[count - 1] = count;
+      ok &= !unrankBatch(order[o], ranks + count - 1, 1, n, batched);
+      ranks[count - 1] = count - 1;
+    }
+    ok &= ranks && batched;
+    free(ranks);
+    free(batched);
 
-      // Now that we have constructed the full permutation we can compute its rank
-      rank = rankRuskeyWilliams(perm, n);
+    void (*batch[3])(const uint8_t *, size_t, int, uint64_t *) = { rank7OrderBatch, rankRuskeyWilliamsBatch, rankLehmerBatch };
+    int simd = useSIMD;
+    for (int o = 0; o < 3; o++){
+      for (useSIMD = 0; useSIMD <= 1; useSIMD++){
+        batch[o](perms, count, n, got);
+        ok &= memcmp(got, want[o], count * sizeof(uint64_t)) == 0;
+      }
     }
-    
-    //printf("rank %d\n", rank);
+    useSIMD = simd;
+
+    printf("ranks n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+    free(perms);
+    free(got);
+    for (int o = 0; o < 3; o++) free(want[o]);
+  }
+  return failed;
+}
 
-    // If the rank is invalid or we have seen this rank before
-    // then the given string is not a universal cycle
-    if (rank < 0 || rank >= L || seen[rank]){
-        free(seen);
-        return 0;
+// The plain verifier the sliding ones are checked against, every window
+// is completed with its missing symbol and ranked from scratch
+static int verifyPerWindow(const unsigned char *U, unsigned long long L, int n){
+  if (L != factorial(n)) return 0;
+  char *seen = calloc(L, 1);
+  int ok = seen != NULL;
+  for (unsigned long long i = 0; ok && i < L; i++){
+    int perm[maxN], present[maxN + 1] = {0};
+    for (int j = 0; ok && j < n - 1; j++){
+      perm[j] = U[(i + j) % L];
+      ok = perm[j] >= 1 && perm[j] <= n && !present[perm[j]];
+      if (ok) present[perm[j]] = 1;
     }
-    // Otherwise mark this rank as seen and continue
-    seen[rank] = 1;
+    for (int x = 1; ok && x <= n; x++) if (!present[x]) perm[n - 1] = x;
+
+    int rank = ok ? rank7Order(perm, n) : -1;
+    ok = rank >= 0 && !seen[rank];
+    if (ok) seen[rank] = 1;
   }
-  // If we have seen all ranks from 0 to n! - 1 then the given string is a universal cycle
   free(seen);
-  return 1;
+  return ok;
 }
-  
-void outputUC(int * UC, int n, FILE *fptr){
-  // If n is less then 10 output the UC as normal to the desired output stream
-  if (n < 10) for (unsigned long long i = 0; i < fact; i++) fprintf(fptr,"%d", UC[i]);
 
-  // If n is greater than or equal to 10 we will have conflicts with overlaping numbers
-  // (ie '1112' could be '1,11,2' or '11,12') and there won't be a good way to distinguish  
-  // between these all of the different possibilities. So as a solution to this problem we    
-  // will output the UC as a string of characters, where 0-9 are represented by '0'-'9' 
-  // and 10-n are represented by A,B,C... This way we can represent all numbers from 0 
-  // to n without any ambiguity. 
-  else{
-    for (unsigned long long i = 0; i < fact; i++){
-      if (UC[i] < 10) fprintf(fptr,"%d", UC[i]);
-      else fprintf(fptr,"%c",UC[i]-10+'A');
+// Self-test: the sliding verifier, on one thread, on several and 
+// partitioned, has to agree with the per-window one on valid cycles,
+// rotations of them and cycles with a symbol changed or two swapped. 
+// Returns the number of failures
+static int testVerification(int lo, int hi){
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    fact = factorial(n);
+    UCBuffer *uc = generateUniversalCycleBuffer(n, UC_BYTE);
+    if (!uc) return failed + 1;
+    unsigned char *U = uc->data;
+    unsigned long long L = uc->len;
+
+    int ok = 1;
+    for (int change = 0; change < 5; change++){
+      unsigned long long i = L / 3 + change;
+      unsigned char a = U[i], b = U[(i + 1) % L];
+      if (change == 1) U[i] = a % n + 1;
+      if (change == 2 || change == 3){
+        U[i] = b;
+        U[(i + 1) % L] = a;
+      }
+      if (change == 4){
+        // Rotating the cycle leaves it valid
+        unsigned char first = U[0];
+        memmove(U, U + 1, L - 1);
+        U[L - 1] = first;
+      }
+
+      int want = verifyPerWindow(U, L, n);
+      ok &= isUniversalCycleSliding(uc, n) == want;
+      ok &= isUniversalCycleParallel(uc, n, 3) == want;
+      ok &= isUniversalCyclePartitioned(uc, n, 2) == want;
+      ok &= (change == 0 || change == 4) == want;
+
+      // Put the cycle back the way it was
+      if (change == 1) U[i] = a;
+      if (change == 2 || change == 3){
+        U[i] = a;
+        U[(i + 1) % L] = b;
+      }
+    }
+
+    printf("verification n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+    freeUCBuffer(uc);
+  }
+  return failed;
+}
+
+// Feed the cycle U to a streaming verifier covering the ranks lo..hi-1
+// in pieces of growing, uneven sizes and return what it finishes with
+static int feedPieces(const unsigned char *U, unsigned long long L, int n, unsigned long long lo, unsigned long long hi){
+  UCVerifier *uv = ucv_open_range(n, lo, hi);
+  if (!uv) return -1;
+  unsigned long long fed = 0, piece = 1;
+  while (fed < L && ucv_feed(uv, U + fed, L - fed < piece ? L - fed : piece)){
+    fed += L - fed < piece ? L - fed : piece;
+    piece = piece * 3 + 1;
+  }
+  int ok = ucv_finish(uv);
+  ucv_close(uv);
+  return ok;
+}
+
+// Self-test: the streaming verifier, fed in uneven pieces over the whole
+// range of ranks or split in two, and verifyStream on the cycle as text
+// have to agree with the per-window verifier on valid cycles and cycles
+// with a symbol changed or two swapped, and so does verifyStreamBudget
+// with a budget small enough that it takes several passes. A cycle that
+// stops short must fail. Returns the number of failures
+static int testStream(int lo, int hi){
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    UCBuffer *uc = generateUniversalCycleBuffer(n, UC_BYTE);
+    unsigned char *text = uc ? malloc(uc->len) : NULL;
+    if (!text){
+      freeUCBuffer(uc);
+      return failed + 1;
+    }
+    unsigned char *U = uc->data;
+    unsigned long long L = uc->len;
+
+    int ok = 1;
+    for (int change = 0; change < 3; change++){
+      unsigned long long i = L / 3;
+      unsigned char a = U[i], b = U[(i + 1) % L];
+      if (change == 1) U[i] = a % n + 1;
+      if (change == 2){
+        U[i] = b;
+        U[(i + 1) % L] = a;
+      }
+
+      int want = verifyPerWindow(U, L, n);
+      ok &= want || change > 0;
+      ok &= feedPieces(U, L, n, 0, L) == want;
+      ok &= (feedPieces(U, L, n, 0, L / 2) && feedPieces(U, L, n, L / 2, L)) == want;
+
+      memcpy(text, U, L);
+      encodeSymbols(text, L);
+      FILE *fptr = tmpfile();
+      ok &= fptr && fwrite(text, 1, L, fptr) == L && fseek(fptr, 0, SEEK_SET) == 0;
+      ok &= fptr && verifyStream(fptr, n) == want;
+
+      // Count the passes from the report, a failed pass ends it early
+      FILE *report = tmpfile();
+      ok &= fptr && report && verifyStreamBudget(fptr, n, (L + 23) / 24, report) == want;
+      int passes = 0;
+      char line[256];
+      if (report) rewind(report);
+      while (report && fgets(line, sizeof(line), report)) passes += strncmp(line, "pass ", 5) == 0;
+      ok &= L <= 64 || !want || passes >= 2;
+      if (report) fclose(report);
+      if (fptr) fclose(fptr);
+
+      U[i] = a;
+      U[(i + 1) % L] = b;
+    }
+    ok &= feedPieces(U, L - 1, n, 0, L) == 0;
+
+    printf("stream n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+    free(text);
+    freeUCBuffer(uc);
+  }
+  return failed;
+}
+
+// Self-test: sharded verification on 2 and 3 shards has to agree with
+// the per-window verifier on valid cycles and cycles with a symbol 
+// changed or two swapped, written as text to the scratch file 
+// selftest.uc, and pass the cycle written as a container. Returns the
+// number of failures
+static int testSharded(int lo, int hi){
+  const char *path = "selftest.uc";
+  int failed = 0;
+  for (int n = lo; n <= hi; n++){
+    UCBuffer *uc = generateUniversalCycleBuffer(n, UC_BYTE);
+    unsigned char *text = uc ? malloc(uc->len) : NULL;
+    if (!text){
+      freeUCBuffer(uc);
+      return failed + 1;
+    }
+    unsigned char *U = uc->data;
+    unsigned long long L = uc->len;
+
+    int ok = 1;
+    for (int change = 0; change < 3; change++){
+      unsigned long long i = L / 3;
+      unsigned char a = U[i], b = U[(i + 1) % L];
+      if (change == 1) U[i] = a % n + 1;
+      if (change == 2){
+        U[i] = b;
+        U[(i + 1) % L] = a;
+      }
+
+      int want = verifyPerWindow(U, L, n);
+      ok &= want || change > 0;
+      memcpy(text, U, L);
+      encodeSymbols(text, L);
+      FILE *fptr = fopen(path, "wb");
+      ok &= fptr && fwrite(text, 1, L, fptr) == L;
+      if (fptr) ok &= fclose(fptr) == 0;
+      for (int shards = 2; shards <= 3; shards++) ok &= verifySharded(path, n, shards, NULL, NULL) == want;
+
+      U[i] = a;
+      U[(i + 1) % L] = b;
     }
+    ok &= ucfile_write(path, n, UCF_RUSKEY_WILLIAMS) && verifySharded(path, 0, 3, NULL, NULL) == 1;
+
+    printf("sharded n=%d: %s\n", n, ok ? "ok" : "FAILED");
+    failed += !ok;
+    free(text);
+    freeUCBuffer(uc);
   }
+  remove(path);
+  return failed;
 }
 
 int main(int argc, char **argv){
+  // '-nosimd' keeps the construction on the scalar kernel
+  if (hasFlag(argc, argv, "-nosimd")) useSIMD = 0;
+
+  // '-bench' times the construction for n = 10..13 and exits
+  if (hasFlag(argc, argv, "-bench")){
+    benchmarkConstruction(10, 13, 200000000ull, stdout);
+    return 0;
+  }
+
+  // '-vbench' times direct and partitioned verification for n = 10..12
+  // (on '-t <threads>' threads) and exits
+  if (hasFlag(argc, argv, "-vbench")){
+    char *threads = flagValue(argc, argv, "-t");
+    benchmarkVerification(10, 12, threads ? atoi(threads) : 1, stdout);
+    return 0;
+  }
+
+  // '-test' runs the self-tests and exits with 1 if any of them fail
+  if (hasFlag(argc, argv, "-test")) return testConstruction(2, 10) + testKernels(17, 20) + testBell7(1, 8) + testContainer(2, 10) + testRanks(1, 8) + testVerification(3, 9) + testStream(1, 9) + testSharded(3, 8) > 0;
+
+  // '-c <file>' checks a binary container, first its checksums and
+  // then that it holds a universal cycle, and exits
+  if (flagValue(argc, argv, "-c")) return checkContainer(flagValue(argc, argv, "-c"));
+
   int n;
   printf("Enter n: ");
   scanf("%d", &n);
@@ -134,28 +673,42 @@ int main(int argc, char **argv){
   // we only have to calculate it one time
   fact = factorial(n);
 
-  int *UC = generateUniversalCycle(n);
-  if (UC == NULL){
-    printf("Error generating universal cycle\n");
-    return 0;
+  int threads = flagValue(argc, argv, "-t") ? atoi(flagValue(argc, argv, "-t")) : 0;
+
+  // The Bell7 construction repeats windows from n = 5 on
+  if (hasFlag(argc, argv, "-7") && n >= 5) fprintf(stderr, "Warning the Bell7 cycle is only a universal cycle for n <= 4\n");
+
+  // '-o <file>' writes the UC (or the 7-order one with '-7') 
+  // to a binary container
+  if (flagValue(argc, argv, "-o")){
+    int algo = hasFlag(argc, argv, "-7") ? UCF_BELL7 : UCF_RUSKEY_WILLIAMS;
+    if (!ucfile_write(flagValue(argc, argv, "-o"), n, algo)) printf("Error writing universal cycle\n");
   }
 
-  // if the user entered '-f' to have the UC outputed to a file
-  // then open the output file and output the UC to it
-  if (argc > 1 && (strcmp(argv[1],"-f") == 0 || (argc > 2 && strcmp(argv[2],"-f") == 0))){
-    FILE *fptr = fopen("UC", "w");
-    outputUC(UC, n, fptr);
-    fclose(fptr);
+  // '-a <file>' writes just Sₙ (with checkpoints) as a compact archive 
+  // of the UC, about 1 bit per symbol
+  else if (flagValue(argc, argv, "-a")){
+    if (!ucfile_write_sn(flagValue(argc, argv, "-a"), n)) printf("Error writing universal cycle\n");
   }
 
-  // If no '-f' arg was given then just output the UC to stdout 
-  else{
-    printf("UC: ");
-    outputUC(UC, n, stdout);
-    printf("\n");
+  // '-v <file>' checks the UC text file (as written by '-f') in place, 
+  // on '-t <threads>' threads
+  else if (flagValue(argc, argv, "-v")){
+    int ok = verifyUCFile(flagValue(argc, argv, "-v"), n, threads);
+    if (ok < 0) return 1;
+    printf("%s\n", ok ? "YES" : "no");
+    return !ok;
   }
-  
-  free(UC);
+
+  // '-f -m' writes the UC to the file through a memory mapping,
+  // generating it (on '-t <threads>' threads) straight into the file
+  else if (hasFlag(argc, argv, "-f") && hasFlag(argc, argv, "-m") && !hasFlag(argc, argv, "-7")){
+    if (!writeUCMapped(n, "UC", threads)){
+      printf("Error writing universal cycle\n");
+      return 1;
+    }
+  }
+  else if (!outputCycle(n, threads, argc, argv)) return 0;
   
 
 
@@ -15,7 +15,7 @@ int rank7Order(int *perm, int n){
     if (pos == 0) return n * rank7Order(perm + 1, n - 1);
     
     // If the permutation has n somewhere other than the first position
-    int m = n - 1;
+    unsigned int m = n - 1;
     int *newPerm = malloc(m * sizeof(int));
     if (!newPerm){
         printf("Memory allocation failed\n");
@@ -56,7 +56,7 @@ int rankRuskeyWilliams(int *perm, int n){
     if (pos == 0) return n * rankRuskeyWilliams(perm + 1, n - 1);
     
     // If the permutation is αnβ
-    int m = n - 1;
+    unsigned int m = n - 1;
     int lenBetta = m - pos;     
     int *newPerm = malloc(m * sizeof(int));
     if (!newPerm){
@@ -84,17 +84,403 @@ int rankRuskeyWilliams(int *perm, int n){
     return n - pos + n * r;
 }
 
+// Fill offset[2..n] with the 7-order digits of perm, offset[s] is s - pos
+// where pos is the position of s at level s, or 0 if s is first there.
+// Removing the larger elements never changes the order of the smaller 
+// ones, so pos is just how many smaller elements come before s in perm.
+// A bitmask of the elements seen so far gives that count with one 
+// popcount. Returns 0 if perm is not a permutation of {1..n}
+int rank7OrderDigits(const int *perm, int n, int *offset){
+    if (n < 1 || n > maxN) return 0;
+
+    unsigned int seen = 0;
+    for (int i = 0; i < n; i++){
+        int x = perm[i];
+        if (x < 1 || x > n || (seen >> x) & 1) return 0;
+        int pos = __builtin_popcount(seen & ((1u << x) - 1));
+        offset[x] = pos == 0 ? 0 : x - pos;
+        seen |= 1u << x;
+    }
+    return 1;
+}
+
+// Iterative version of rank7Order that returns the same ranks in O(n) 
+// time without allocating, and in 64 bits so it works for all n up to 
+// maxN. Returns -1 if perm is not a permutation of {1..n}
+long long rank7OrderFast(const int *perm, int n){
+    int offset[maxN + 1];
+    if (!rank7OrderDigits(perm, n, offset)) return -1;
+
+    // rank = offset[n] + n·(offset[n-1] + (n-1)·(...))
+    long long rank = 0;
+    for (int s = 2; s <= n; s++) rank = offset[s] + s * rank;
+    return rank;
+}
+
+// Iterative version of rankRuskeyWilliams that returns the same ranks in
+// O(n) time without allocating, and in 64 bits so it works for all n up 
+// to maxN. Instead of building σ(β)α at every level the elements stay in
+// their slots and the permutation at a level is read cyclically over the
+// slots still alive, starting at slot h. Going from αsβ to σ(β)α is then
+// O(1): the last element of β (the alive slot just before h) moves into 
+// the slot of s and reading starts there. If s is first its slot is 
+// dropped and h moves on, if β is empty the slot of s is just dropped. 
+// The position of s is a popcount of the alive slots between h and it.
+// Returns -1 if perm is not a permutation of {1..n}
+long long rankRuskeyWilliamsFast(const int *perm, int n){
+    if (n < 1 || n > maxN) return -1;
+
+    // inv[x] is the slot holding x
+    int slot[maxN], inv[maxN + 1];
+    unsigned int seen = 0;
+    for (int i = 0; i < n; i++){
+        int x = perm[i];
+        if (x < 1 || x > n || (seen >> x) & 1) return -1;
+        seen |= 1u << x;
+        slot[i] = x;
+        inv[x] = i;
+    }
+
+    unsigned int alive = (1u << n) - 1;
+    int h = 0;
+    long long rank = 0, mult = 1;
+    for (int s = n; s >= 2; s--){
+        // Count the alive slots from h up to (not including) the slot of s
+        int x = inv[s];
+        int pos = x >= h ? __builtin_popcount(alive & ((1u << x) - (1u << h)))
+                         : __builtin_popcount(alive >> h) + __builtin_popcount(alive & ((1u << x) - 1));
+        int lenBetta = s - 1 - pos;
+
+        if (pos == 0){
+            // s is first so carry on with the rest, from the next alive slot
+            alive &= ~(1u << x);
+            unsigned int after = alive & ~((1u << h) - 1);
+            h = __builtin_ctz(after ? after : alive);
+        }
+        else{
+            rank += (s - pos) * mult;
+            if (lenBetta == 0) alive &= ~(1u << x);
+            else{
+                // Move the last element of β into the slot of s
+                unsigned int before = alive & ((1u << h) - 1);
+                int t = 31 - __builtin_clz(before ? before : alive);
+                slot[x] = slot[t];
+                inv[slot[x]] = x;
+                alive &= ~(1u << t);
+                h = x;
+            }
+        }
+        mult *= s;
+    }
+    return rank;
+}
+
+// Inverse of rankRuskeyWilliams, fill perm[0..n-1] with the permutation
+// of {1..n} whose rank is the given rank in [0..n!-1]. This undoes the 
+// recursion from the bottom up, at level s the rank gives the offset 
+// s - pos of s and the rank of σ(β)α one level down, so starting from
+// the single permutation 1 we rebuild αsβ from σ(β)α one level at a time.
+// Returns 0 if n or the rank is out of range and 1 otherwise
+int unrankRuskeyWilliams(unsigned long long rank, int n, int *perm){
+    if (n < 1 || n > maxN || rank >= factorial(n)) return 0;
+
+    // Peel the offset of each level off the rank
+    int offset[maxN + 1];
+    for (int s = n; s >= 2; s--){
+        offset[s] = rank % s;
+        rank /= s;
+    }
+
+    perm[0] = 1;
+    for (int s = 2; s <= n; s++){
+        // perm[0..s-2] holds σ(β)α, if s is in position 0 then 
+        // α = ε and σ(β)α is just the rest of the permutation
+        int tmp[maxN], t = 0;
+        if (offset[s] == 0){
+            tmp[t++] = s;
+            for (int i = 0; i < s - 1; i++) tmp[t++] = perm[i];
+        }
+        else{
+            int pos = s - offset[s];
+            int lenBetta = s - 1 - pos;
+
+            // α is everything after σ(β), then comes s and then β 
+            // which is σ(β) rotated back one position to the left
+            for (int i = lenBetta; i < s - 1; i++) tmp[t++] = perm[i];
+            tmp[t++] = s;
+            for (int i = 1; i < lenBetta; i++) tmp[t++] = perm[i];
+            if (lenBetta > 0) tmp[t++] = perm[0];
+        }
+        for (int i = 0; i < s; i++) perm[i] = tmp[i];
+    }
+    return 1;
+}
+
+// Inverse of rank7Order, fill perm[0..n-1] with the permutation of 
+// {1..n} whose rank is the given rank in [0..n!-1]. At level s the rank
+// gives the offset s - pos of s (0 when s is first) so starting from the
+// single permutation 1 we insert 2, 3, ..., n at their positions. 
+// Returns 0 if n or the rank is out of range and 1 otherwise
+int unrank7Order(unsigned long long rank, int n, int *perm){
+    if (n < 1 || n > maxN || rank >= factorial(n)) return 0;
+
+    // Peel the offset of each level off the rank
+    int offset[maxN + 1];
+    for (int s = n; s >= 2; s--){
+        offset[s] = rank % s;
+        rank /= s;
+    }
+
+    perm[0] = 1;
+    for (int s = 2; s <= n; s++){
+        int pos = offset[s] == 0 ? 0 : s - offset[s];
+
+        // Shift everything from pos on one to the right to make room for s
+        for (int i = s - 1; i > pos; i--) perm[i] = perm[i - 1];
+        perm[pos] = s;
+    }
+    return 1;
+}
+
+// Inverse of the Lehmer code rank used by rankLehmer, fill perm[0..n-1] 
+// with the permutation of {1..n} whose rank is the given rank in 
+// [0..n!-1]. Digit i of the code counts the unused symbols smaller than
+// perm[i], so each step takes the digit-th smallest symbol still unused.
+// Returns 0 if n or the rank is out of range and 1 otherwise
+int unrankLehmer(unsigned long long rank, int n, int *perm){
+    if (n < 1 || n > maxN || rank >= factorial(n)) return 0;
+    char used[maxN + 1] = {0};
+    unsigned long long factN = factorial(n - 1);
+
+    for (int i = 0; i < n; i++){
+        int digit = rank / factN;
+        rank %= factN;
+        if (i < n - 1) factN /= (n - 1 - i);
+
+        // Walk past digit unused symbols to the one we want
+        int x = 1;
+        while (used[x]) x++;
+        while (digit-- > 0){
+            x++;
+            while (used[x]) x++;
+        }
+        used[x] = 1;
+        perm[i] = x;
+    }
+    return 1;
+}
+
+// Unrank count ranks in the given order (one of RANK_7ORDER, 
+// RANK_RUSKEY_WILLIAMS or RANK_LEHMER) into perms, which holds count 
+// permutations of n one after another so rank i lands in 
+// perms[i*n..i*n+n-1]. Returns 0 for an unknown order or if any rank 
+// is out of range, and 1 otherwise
+int unrankBatch(int order, const unsigned long long *ranks, unsigned long long count, int n, int *perms){
+    int (*unrank)(unsigned long long, int, int *);
+    if (order == RANK_7ORDER) unrank = unrank7Order;
+    else if (order == RANK_RUSKEY_WILLIAMS) unrank = unrankRuskeyWilliams;
+    else if (order == RANK_LEHMER) unrank = unrankLehmer;
+    else{
+        fprintf(stderr, "Unknown order %d\n", order);
+        return 0;
+    }
+
+    int ok = 1;
+    for (unsigned long long i = 0; i < count; i++) ok &= unrank(ranks[i], n, perms + i * n);
+    return ok;
+}
+
+// 0! to 20!, every factorial a rank of n ≤ maxN can need
+static const unsigned long long factTable[maxN + 1] = {
+    1ull, 1ull, 2ull, 6ull, 24ull, 120ull, 720ull, 5040ull, 40320ull, 
+    362880ull, 3628800ull, 39916800ull, 479001600ull, 6227020800ull,
+    87178291200ull, 1307674368000ull, 20922789888000ull, 355687428096000ull,
+    6402373705728000ull, 121645100408832000ull, 2432902008176640000ull
+};
+
+// Lehmer code rank of the permutation perm of {1..n} in [0..n!-1], the 
+// same rank rankLehmer gives its window. Digit i counts the symbols 
+// after perm[i] that are smaller than it, which is the number of smaller
+// symbols not used yet. Keeping the used symbols in a bitmask makes that
+// one popcount so the rank takes O(n) instead of O(n²). Returns -1 if 
+// perm is not a permutation of {1..n}
+long long rankLehmerFast(const int *perm, int n){
+    if (n < 1 || n > maxN) return -1;
+
+    unsigned int used = 0;
+    long long rank = 0;
+    for (int i = 0; i < n; i++){
+        int x = perm[i];
+        if (x < 1 || x > n || (used >> x) & 1) return -1;
+
+        // x - 1 symbols are smaller than x, minus the ones already used
+        int smaller = x - 1 - __builtin_popcount(used & ((1u << x) - 1));
+        rank += smaller * factTable[n - 1 - i];
+        used |= 1u << x;
+    }
+    return rank;
+}
+
+// Batch ranking. The permutations are stored structure of arrays, 
+// element i of permutation k is perms[i * count + k], so the same element
+// of many permutations sits in consecutive bytes and can be compared 32 
+// at a time in the byte lanes of an AVX2 register. Every permutation must
+// be a permutation of {1..n}, nothing is checked. Both ranks are Horner
+// sums of small digits, r = r·m + digit, so the digits are worked out 
+// for a block of 32 permutations with byte compares and then folded into
+// 64 bit ranks four lanes at a time
+
+// Copy permutation k out of the structure of arrays layout into perm
+static void batchPerm(const uint8_t *perms, size_t count, int n, size_t k, int *perm){
+    for (int i = 0; i < n; i++) perm[i] = perms[i * count + k];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// Fold the byte digits digit[first..last][0..31] of a block into the 32 
+// ranks with r = r·mult[t] + digit[t]. The multiplier is at most 20 so
+// a 64 by 32 bit multiply is two 32 bit ones
+__attribute__((target("avx2")))
+static void foldDigits(uint8_t digit[][32], const int *mult, int first, int last, uint64_t *ranks){
+    for (int g = 0; g < 32; g += 4){
+        __m256i r = _mm256_setzero_si256();
+        for (int t = first; t <= last; t++){
+            __m256i m = _mm256_set1_epi64x(mult[t]);
+            __m256i lo = _mm256_mul_epu32(r, m);
+            __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(r, 32), m);
+            r = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+
+            int four;
+            memcpy(&four, &digit[t][g], sizeof(four));
+            r = _mm256_add_epi64(r, _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four)));
+        }
+        _mm256_storeu_si256((__m256i *)(ranks + g), r);
+    }
+}
+
+// Lehmer digit i counts the later elements smaller than perm[i], rank = 
+// Σ digit[i]·(n-1-i)! which is r = r·(n-i) + digit[i] for i = 0..n-1
+__attribute__((target("avx2")))
+static size_t rankLehmerAVX2(const uint8_t *perms, size_t count, int n, uint64_t *ranks){
+    uint8_t digit[maxN][32];
+    int mult[maxN];
+    for (int i = 0; i < n; i++) mult[i] = n - i;
+
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32){
+        __m256i p[maxN];
+        for (int i = 0; i < n; i++) p[i] = _mm256_loadu_si256((const __m256i *)(perms + i * count + k));
+
+        for (int i = 0; i < n; i++){
+            // A true compare is all ones, -1, so subtracting it counts
+            __m256i c = _mm256_setzero_si256();
+            for (int j = i + 1; j < n; j++) c = _mm256_sub_epi8(c, _mm256_cmpgt_epi8(p[i], p[j]));
+            _mm256_storeu_si256((__m256i *)digit[i], c);
+        }
+        foldDigits(digit, mult, 0, n - 1, ranks + k);
+    }
+    return k;
+}
+
+// The 7-order digit of s is s - pos (0 if pos is 0) where pos counts the 
+// smaller elements before s, rank = r·s + digit[s] for s = 1..n. The 
+// digits are indexed by value so the position of every value is found
+// first, then pos is the number of smaller values at an earlier position
+__attribute__((target("avx2")))
+static size_t rank7OrderAVX2(const uint8_t *perms, size_t count, int n, uint64_t *ranks){
+    uint8_t digit[maxN + 1][32];
+    int mult[maxN + 1];
+    for (int s = 1; s <= n; s++) mult[s] = s;
+
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32){
+        __m256i p[maxN], inv[maxN + 1];
+        for (int i = 0; i < n; i++) p[i] = _mm256_loadu_si256((const __m256i *)(perms + i * count + k));
+
+        for (int s = 1; s <= n; s++){
+            __m256i value = _mm256_set1_epi8(s);
+            inv[s] = _mm256_setzero_si256();
+            for (int i = 0; i < n; i++)
+                inv[s] = _mm256_or_si256(inv[s], _mm256_and_si256(_mm256_cmpeq_epi8(p[i], value), _mm256_set1_epi8(i)));
+        }
+
+        for (int s = 1; s <= n; s++){
+            __m256i pos = _mm256_setzero_si256();
+            for (int t = 1; t < s; t++) pos = _mm256_sub_epi8(pos, _mm256_cmpgt_epi8(inv[s], inv[t]));
+            __m256i o = _mm256_sub_epi8(_mm256_set1_epi8(s), pos);
+            o = _mm256_andnot_si256(_mm256_cmpeq_epi8(pos, _mm256_setzero_si256()), o);
+            _mm256_storeu_si256((__m256i *)digit[s], o);
+        }
+        foldDigits(digit, mult, 1, n, ranks + k);
+    }
+    return k;
+}
+#endif
+
+// Rank count permutations in the 7-order into ranks
+void rank7OrderBatch(const uint8_t *perms, size_t count, int n, uint64_t *ranks){
+    if (n < 1 || n > maxN) return;
+    size_t k = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (useSIMD && __builtin_cpu_supports("avx2")) k = rank7OrderAVX2(perms, count, n, ranks);
+#endif
+    int perm[maxN];
+    for (; k < count; k++){
+        batchPerm(perms, count, n, k, perm);
+        ranks[k] = rank7OrderFast(perm, n);
+    }
+}
+
+// Rank count permutations by their Lehmer code into ranks
+void rankLehmerBatch(const uint8_t *perms, size_t count, int n, uint64_t *ranks){
+    if (n < 1 || n > maxN) return;
+    size_t k = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if (useSIMD && __builtin_cpu_supports("avx2")) k = rankLehmerAVX2(perms, count, n, ranks);
+#endif
+    int perm[maxN];
+    for (; k < count; k++){
+        batchPerm(perms, count, n, k, perm);
+        ranks[k] = rankLehmerFast(perm, n);
+    }
+}
+
+// Rank count permutations in the Ruskey–Williams order into ranks. Each
+// level of this rank reorders the permutation depending on where n is, 
+// which does not map onto lanes, so this one is always scalar
+void rankRuskeyWilliamsBatch(const uint8_t *perms, size_t count, int n, uint64_t *ranks){
+    if (n < 1 || n > maxN) return;
+    int perm[maxN];
+    for (size_t k = 0; k < count; k++){
+        batchPerm(perms, count, n, k, perm);
+        ranks[k] = rankRuskeyWilliamsFast(perm, n);
+    }
+}
+
 // Given U of length L and parameters n, rank the substring of length n-1
 // starting at index 'start' (circularly).  Returns a rank in [0..n!-1] or 
 // -1 if the substring is invalid
 int rankLehmer(int *U, int L, int n, int start){
+    UCBuffer uc = { UC_INT, 0, L, U };
+    return rankLehmerBuffer(&uc, n, start);
+}
+
+// Same as rankLehmer but reads the substring straight out of a
+// universal cycle buffer in any of its storage modes
+long long rankLehmerBuffer(const UCBuffer *uc, int n, unsigned long long start){
+    // The window of n = 1 is empty and its one permutation has rank 0,
+    // the arrays below would be zero length
+    if (n < 2) return n == 1 ? 0 : -1;
+
+    unsigned long long L = uc->len;
     char used[n]; // tracks which of 1..n appear in the substring
     memset(used, 0, sizeof(char) * n); // initialize to false
     int window[n-1],  sum = 0; 
 
     for (int t = 0; t < n - 1; t++){
         // Get the symbol at the current position in the circular substring
-        int x = U[(start + t) % L];
+        int x = getSymbol(uc, (start + t) % L);
 
         // Make sure that they are within 1...n
         if (x < 1 || x > n){
@@ -121,19 +507,5 @@ int rankLehmer(int *U, int L, int n, int start){
     pi[n - 1] = missing;
 
     // Compute its Lehmer‐code rank in [0..n!-1]
-    int rank = 0;
-    unsigned long long factN = factorial(n - 1);
-    for (unsigned int i = 0; i < n; i++){
-        int smaller = 0;
-        // Count how many of the remaining symbols are smaller than pi[i]
-        for (unsigned int j = i + 1; j < n; j++) if (pi[j] < pi[i]) smaller++;
-
-        // Update the rank
-        rank += smaller * factN;
-        if (i < n - 1){
-            factN /= (n - 1 - i);
-        }
-    }
-
-    return rank;
-}
\ No newline at end of file
+    return rankLehmerFast(pi, n);
+}
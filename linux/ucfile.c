@@ -0,0 +1,608 @@
+#define _DEFAULT_SOURCE
+#include "constructAndRank.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// How much of the mapping a writer fills before it lets go of the 
+// pages behind it, and how much it generates at a time
+#define MAP_FLUSH (64ull << 20)
+#define MAP_CHUNK (1ull << 20)
+
+// Turn symbols into the characters used by outputUC, '0'-'9' and then
+// A,B,C... from 10 onwards
+void encodeSymbols(unsigned char *buf, unsigned long long len){
+    for (unsigned long long i = 0; i < len; i++) buf[i] = buf[i] < 10 ? buf[i] + '0' : buf[i] - 10 + 'A';
+}
+
+// The part of the mapped file written by one thread
+typedef struct {
+    int n;
+    unsigned char *map;
+    unsigned long long start;
+    unsigned long long end;
+    int failed;
+} MapSlice;
+
+// Generate the slice straight into the mapping and tell the kernel 
+// it can drop the pages behind the write cursor, they are already 
+// in the page cache and will be written back from there
+static void * writeSlice(void *arg){
+    MapSlice *sl = arg;
+
+    // Rounding slices up to whole pages can leave the last ones empty
+    if (sl->start >= sl->end) return NULL;
+    UCStream *g = uc_open_at(sl->n, sl->start);
+    if (!g){
+        sl->failed = 1;
+        return NULL;
+    }
+
+    unsigned long long dropped = sl->start;
+    for (unsigned long long pos = sl->start; pos < sl->end; ){
+        unsigned long long len = (sl->end - pos < MAP_CHUNK) ? sl->end - pos : MAP_CHUNK;
+        len = uc_fill(g, sl->map + pos, len);
+        encodeSymbols(sl->map + pos, len);
+        pos += len;
+
+        if (pos - dropped >= MAP_FLUSH){
+            madvise(sl->map + dropped, pos - dropped, MADV_DONTNEED);
+            dropped = pos;
+        }
+    }
+
+    uc_close(g);
+    return NULL;
+}
+
+// Write the UC for Π(n) to the file at path, in the same characters as 
+// outputUC, without ever holding it in memory. The file is created at 
+// its final size of n! bytes and mapped, and the generator (split over
+// the given number of threads, each seeking to its own page aligned 
+// slice) writes the symbols straight into the mapping. Returns 1 on 
+// success and 0 on failure
+int writeUCMapped(int n, const char *path, int threads){
+    if (n < 1 || n > maxN) return 0;
+    unsigned long long total = factorial(n);
+    if (threads < 1) threads = 1;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){
+        fprintf(stderr, "Error opening %s\n", path);
+        return 0;
+    }
+    if (ftruncate(fd, total) != 0){
+        fprintf(stderr, "Error resizing %s\n", path);
+        close(fd);
+        return 0;
+    }
+
+    unsigned char *map = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED){
+        fprintf(stderr, "Error mapping %s\n", path);
+        return 0;
+    }
+    madvise(map, total, MADV_SEQUENTIAL);
+
+    MapSlice *slices = malloc(threads * sizeof(MapSlice));
+    pthread_t *tid = malloc(threads * sizeof(pthread_t));
+    int *started = calloc(threads, sizeof(int));
+    if (!slices || !tid || !started){
+        fprintf(stderr, "Memory allocation failed\n");
+        free(slices);
+        free(tid);
+        free(started);
+        munmap(map, total);
+        return 0;
+    }
+
+    // Slices start on page boundaries so madvise never touches a 
+    // page that another thread is still writing
+    unsigned long long page = sysconf(_SC_PAGESIZE);
+    unsigned long long per = ((total + threads - 1) / threads + page - 1) / page * page;
+    for (int t = 0; t < threads; t++){
+        unsigned long long start = t * per < total ? t * per : total;
+        unsigned long long end = start + per < total ? start + per : total;
+        slices[t] = (MapSlice){ n, map, start, end, 0 };
+    }
+    for (int t = 1; t < threads; t++) started[t] = pthread_create(&tid[t], NULL, writeSlice, &slices[t]) == 0;
+    writeSlice(&slices[0]);
+
+    int ok = !slices[0].failed;
+    for (int t = 1; t < threads; t++){
+        if (started[t]) pthread_join(tid[t], NULL);
+        else writeSlice(&slices[t]);
+        ok &= !slices[t].failed;
+    }
+
+    munmap(map, total);
+    free(slices);
+    free(tid);
+    free(started);
+    return ok;
+}
+
+// CRC32C (Castagnoli) lookup table for the software version
+static unsigned int crcTable[256];
+
+static void crcInit(){
+    for (unsigned int i = 0; i < 256; i++){
+        unsigned int c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+        crcTable[i] = c;
+    }
+}
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+// The SSE 4.2 crc32 instruction computes CRC32C 8 bytes at a time
+__attribute__((target("sse4.2")))
+static unsigned int crc32cHW(unsigned int crc, const unsigned char *p, size_t len){
+    unsigned long long c = crc;
+    for (; len >= 8; len -= 8, p += 8){
+        unsigned long long w;
+        memcpy(&w, p, 8);
+        c = _mm_crc32_u64(c, w);
+    }
+    for (; len > 0; len--) c = _mm_crc32_u8(c, *p++);
+    return c;
+}
+#endif
+
+// Return the CRC32C of len bytes at buf, continuing from crc (pass 0
+// to start a new checksum). Uses the crc32 instruction when the CPU 
+// has SSE 4.2 and a lookup table otherwise
+unsigned int crc32c(unsigned int crc, const void *buf, size_t len){
+    const unsigned char *p = buf;
+    crc = ~crc;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) return ~crc32cHW(crc, p, len);
+#endif
+    if (crcTable[1] == 0) crcInit();
+    for (size_t i = 0; i < len; i++) crc = crcTable[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+// The binary container for a universal cycle. The file starts with a 
+// UCFileHeader, then comes a table with one UCFileChunk per chunk and
+// then the payload. The payload is split into chunks of chunkSymbols 
+// symbols (a multiple of 64) packed like a UC_PACKED buffer, so each 
+// chunk is a whole number of 64 bit words and the chunks laid end to 
+// end form one packed array. Every chunk has its own CRC32C so a reader
+// can check just the part it uses. All fields are little endian.
+//
+// A Ruskey–Williams cycle is fully determined by n and Sₙ, so the 
+// UCF_SN_BITS payload stores just one bit of Sₙ per symbol. Each of its
+// chunks starts with a checkpoint, the permutation at the first symbol 
+// of the chunk as SN_CHECKPOINT bytes, followed by the Sₙ bits for the 
+// chunk packed 64 to a word. A reader can jump to any chunk and rebuild
+// its symbols by replaying the rotations from the checkpoint
+#define UCF_MAGIC "UCYCLE\0\1"
+#define UCF_VERSION 1
+#define UCF_CHUNK_SYMBOLS (1ull << 20)
+#define SN_CHUNK_SYMBOLS (1ull << 16)
+#define SN_CHECKPOINT 24
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t n;
+    uint32_t algo;            // UCF_RUSKEY_WILLIAMS or UCF_BELL7
+    uint32_t payload;         // UCF_SYMBOLS
+    uint32_t bits;            // bits per symbol in the payload
+    uint32_t chunkSymbols;    // symbols per chunk
+    uint64_t length;          // number of symbols, n!
+    uint64_t chunks;          // number of chunks
+    uint64_t reserved[2];
+} UCFileHeader;
+
+typedef struct {
+    uint64_t offset;          // byte offset of the chunk in the file
+    uint32_t bytes;           // size of the chunk
+    uint32_t crc;             // CRC32C of the chunk
+} UCFileChunk;
+
+struct UCFile {
+    unsigned char *map;
+    unsigned long long size;
+    const UCFileHeader *head;
+    const UCFileChunk *table;
+};
+
+// Write the universal cycle for Π(n) to the container at path, either 
+// as packed symbols built by the given algorithm or (for the 
+// Ruskey–Williams cycle only) as the UCF_SN_BITS archive. The cycle is
+// pulled from the streaming generator a chunk at a time so only one 
+// chunk is ever in memory. Returns 1 on success and 0 on failure
+static int writeContainer(const char *path, int n, int algo, int payload){
+    if (n < 1 || n > maxN) return 0;
+    if (payload == UCF_SN_BITS) algo = UCF_RUSKEY_WILLIAMS;
+
+    UCFileHeader head = { UCF_MAGIC, UCF_VERSION, n, algo, payload };
+    head.bits = payload == UCF_SN_BITS ? 1 : (n <= 15 ? 4 : 5);
+    head.chunkSymbols = payload == UCF_SN_BITS ? SN_CHUNK_SYMBOLS : UCF_CHUNK_SYMBOLS;
+    head.length = factorial(n);
+    head.chunks = (head.length + head.chunkSymbols - 1) / head.chunkSymbols;
+
+    UCFileChunk *table = calloc(head.chunks, sizeof(UCFileChunk));
+    unsigned char *block = malloc(head.chunkSymbols);
+    UCBuffer *packed = newUCBuffer(n, head.chunkSymbols, UC_PACKED);
+    UCStream *g = NULL;
+    Bell7Stream *b = NULL;
+    if (algo == UCF_BELL7) b = bell7_open(n);
+    else g = uc_open(n);
+    FILE *fptr = fopen(path, "wb");
+
+    int ok = table && block && packed && (g || b) && fptr;
+    if (!ok) fprintf(stderr, "Error setting up %s\n", path);
+
+    // Leave room for the header and the table, they are written last
+    // once every chunk's checksum is known
+    unsigned long long offset = sizeof(head) + head.chunks * sizeof(UCFileChunk);
+    if (ok) ok = fseek(fptr, offset, SEEK_SET) == 0;
+
+    for (unsigned long long c = 0; ok && c < head.chunks; c++){
+        unsigned char *data = packed->data;
+        unsigned long long got;
+        unsigned int bytes;
+
+        if (payload == UCF_SN_BITS){
+            // The checkpoint and then the bits
+            int perm[maxN];
+            uc_current_perm(g, perm);
+            memset(data, 0, SN_CHECKPOINT);
+            for (int i = 0; i < n; i++) data[i] = perm[i];
+            got = uc_fill_bits(g, (unsigned long long *)(data + SN_CHECKPOINT), head.chunkSymbols);
+            bytes = SN_CHECKPOINT + (got + 63) / 64 * 8;
+        }
+        else{
+            got = b ? bell7_fill(b, block, head.chunkSymbols) : uc_fill(g, block, head.chunkSymbols);
+            memset(data, 0, (head.chunkSymbols * head.bits) / 8);
+            for (unsigned long long i = 0; i < got; i++) setSymbol(packed, i, block[i]);
+            bytes = (got * head.bits + 63) / 64 * 8;
+        }
+
+        table[c] = (UCFileChunk){ offset, bytes, crc32c(0, data, bytes) };
+        ok = fwrite(data, 1, bytes, fptr) == bytes;
+        offset += bytes;
+    }
+
+    if (ok) ok = fseek(fptr, 0, SEEK_SET) == 0
+              && fwrite(&head, sizeof(head), 1, fptr) == 1
+              && fwrite(table, sizeof(UCFileChunk), head.chunks, fptr) == head.chunks;
+    if (fptr && fclose(fptr) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "Error writing %s\n", path);
+
+    free(table);
+    free(block);
+    freeUCBuffer(packed);
+    if (b) bell7_close(b);
+    if (g) uc_close(g);
+    return ok;
+}
+
+// Write the cycle built by the given algorithm as packed symbols
+int ucfile_write(const char *path, int n, int algo){
+    return writeContainer(path, n, algo, UCF_SYMBOLS);
+}
+
+// Write the Ruskey–Williams cycle as an Sₙ archive, 1 bit per symbol
+// plus a checkpoint every SN_CHUNK_SYMBOLS symbols
+int ucfile_write_sn(const char *path, int n){
+    return writeContainer(path, n, UCF_RUSKEY_WILLIAMS, UCF_SN_BITS);
+}
+
+// Return 1 if head is the header of a container this version can read
+static int validHeader(const UCFileHeader *head){
+    return memcmp(head->magic, UCF_MAGIC, 8) == 0 && head->version == UCF_VERSION
+        && head->n >= 1 && head->n <= maxN && head->length == factorial(head->n)
+        && (head->payload == UCF_SYMBOLS || head->payload == UCF_SN_BITS)
+        && head->bits == (head->payload == UCF_SN_BITS ? 1 : (head->n <= 15 ? 4 : 5))
+        && head->chunkSymbols == (head->payload == UCF_SN_BITS ? SN_CHUNK_SYMBOLS : UCF_CHUNK_SYMBOLS)
+        && head->chunks == (head->length + head->chunkSymbols - 1) / head->chunkSymbols;
+}
+
+// The size chunk c has to be, its packed symbols or its checkpoint and 
+// bits rounded up to whole words
+static unsigned long long chunkBytes(const UCFileHeader *head, unsigned long long c){
+    unsigned long long first = c * head->chunkSymbols;
+    unsigned long long len = head->length - first < head->chunkSymbols ? head->length - first : head->chunkSymbols;
+    return head->payload == UCF_SN_BITS ? SN_CHECKPOINT + (len + 63) / 64 * 8 : (len * head->bits + 63) / 64 * 8;
+}
+
+// Open the container at path by mapping it. The header and the chunk 
+// table are checked but the chunk checksums are not, use 
+// ucfile_check_chunk for that. Returns NULL if the file is not a valid
+// container
+UCFile * ucfile_open(const char *path){
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        fprintf(stderr, "Error opening %s\n", path);
+        return NULL;
+    }
+    unsigned long long size = lseek(fd, 0, SEEK_END);
+    unsigned char *map = size >= sizeof(UCFileHeader) ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED){
+        fprintf(stderr, "Error mapping %s\n", path);
+        return NULL;
+    }
+
+    const UCFileHeader *head = (const UCFileHeader *)map;
+    const UCFileChunk *table = (const UCFileChunk *)(map + sizeof(UCFileHeader));
+    int ok = validHeader(head) && sizeof(UCFileHeader) + head->chunks * sizeof(UCFileChunk) <= size;
+    for (unsigned long long c = 0; ok && c < head->chunks; c++)
+        ok = table[c].offset % 8 == 0 && table[c].bytes == chunkBytes(head, c) && table[c].offset + table[c].bytes <= size;
+    if (!ok){
+        fprintf(stderr, "Error %s is not a universal cycle container\n", path);
+        munmap(map, size);
+        return NULL;
+    }
+
+    UCFile *f = malloc(sizeof(UCFile));
+    if (!f){
+        munmap(map, size);
+        return NULL;
+    }
+    *f = (UCFile){ map, size, head, table };
+    return f;
+}
+
+void ucfile_close(UCFile *f){
+    if (!f) return;
+    munmap(f->map, f->size);
+    free(f);
+}
+
+int ucfile_n(const UCFile *f){ return f->head->n; }
+int ucfile_algo(const UCFile *f){ return f->head->algo; }
+int ucfile_payload(const UCFile *f){ return f->head->payload; }
+unsigned long long ucfile_length(const UCFile *f){ return f->head->length; }
+unsigned long long ucfile_chunks(const UCFile *f){ return f->head->chunks; }
+
+// Return 1 if chunk c matches its checksum
+int ucfile_check_chunk(const UCFile *f, unsigned long long c){
+    if (c >= f->head->chunks) return 0;
+    return crc32c(0, f->map + f->table[c].offset, f->table[c].bytes) == f->table[c].crc;
+}
+
+// The number of symbols in chunk c
+static unsigned long long chunkLength(const UCFile *f, unsigned long long c){
+    unsigned long long first = c * f->head->chunkSymbols;
+    return f->head->length - first < f->head->chunkSymbols ? f->head->length - first : f->head->chunkSymbols;
+}
+
+// A packed buffer that reads chunk c of a UCF_SYMBOLS payload in place
+static UCBuffer chunkView(const UCFile *f, unsigned long long c){
+    return (UCBuffer){ UC_PACKED, f->head->bits, chunkLength(f, c), f->map + f->table[c].offset };
+}
+
+// Rebuild the first len symbols of chunk c of an Sₙ archive into out
+// from its checkpoint
+static void expandChunk(const UCFile *f, unsigned long long c, unsigned long long len, unsigned char *out){
+    const unsigned char *data = f->map + f->table[c].offset;
+    int perm[maxN];
+    for (unsigned int i = 0; i < f->head->n; i++) perm[i] = data[i];
+    expandSnBits(f->head->n, perm, (const unsigned long long *)(data + SN_CHECKPOINT), len, out);
+}
+
+// Return the symbol at index i of the cycle, jumping straight to its 
+// chunk (and replaying from the chunk's checkpoint for an Sₙ archive).
+// Returns -1 if i is past the end of the cycle
+int ucfile_symbol(const UCFile *f, unsigned long long i){
+    if (i >= f->head->length) return -1;
+    unsigned long long c = i / f->head->chunkSymbols;
+    if (f->head->payload == UCF_SN_BITS){
+        unsigned char out[SN_CHUNK_SYMBOLS];
+        expandChunk(f, c, i % f->head->chunkSymbols + 1, out);
+        return out[i % f->head->chunkSymbols];
+    }
+    UCBuffer view = chunkView(f, c);
+    return getSymbol(&view, i % f->head->chunkSymbols);
+}
+
+// Copy the symbols start..start+len-1 of the cycle into buf, checking 
+// the checksum of every chunk they come from. Returns the number of
+// symbols copied, which is less than len if a chunk is corrupt or the 
+// end of the cycle was reached
+unsigned long long ucfile_read(const UCFile *f, unsigned long long start, unsigned char *buf, unsigned long long len){
+    unsigned long long done = 0;
+    while (done < len && start + done < f->head->length){
+        unsigned long long c = (start + done) / f->head->chunkSymbols;
+        if (!ucfile_check_chunk(f, c)) break;
+
+        unsigned long long i = (start + done) % f->head->chunkSymbols;
+        unsigned long long chunkLen = chunkLength(f, c);
+        if (f->head->payload == UCF_SN_BITS){
+            unsigned char out[SN_CHUNK_SYMBOLS];
+            unsigned long long need = (len - done < chunkLen - i) ? i + len - done : chunkLen;
+            expandChunk(f, c, need, out);
+            memcpy(buf + done, out + i, need - i);
+            done += need - i;
+            continue;
+        }
+
+        UCBuffer view = chunkView(f, c);
+        for (; i < view.len && done < len; i++) buf[done++] = getSymbol(&view, i);
+    }
+    return done;
+}
+
+// Return a packed buffer that reads the whole cycle in place out of the
+// mapping, so it can be handed to isUniversalCycleBuffer and the other
+// buffer readers without being copied. Returns NULL if the chunks are 
+// not laid out end to end or the file is an Sₙ archive. Free it with 
+// free(), not freeUCBuffer()
+UCBuffer * ucfile_buffer(const UCFile *f){
+    if (f->head->payload != UCF_SYMBOLS) return NULL;
+    unsigned long long stride = f->head->chunkSymbols / 64 * f->head->bits * 8;
+    for (unsigned long long c = 1; c < f->head->chunks; c++)
+        if (f->table[c].offset != f->table[0].offset + c * stride) return NULL;
+
+    UCBuffer *uc = malloc(sizeof(UCBuffer));
+    if (uc) *uc = (UCBuffer){ UC_PACKED, f->head->bits, f->head->length, f->map + f->table[0].offset };
+    return uc;
+}
+
+// Reading a container front to back from a pipe or any other FILE that
+// cannot be mapped or seeked. The chunks are written in order after the
+// table so one chunk at a time is read, checked against its CRC32C and 
+// decoded into symbols
+struct UCFileStream {
+    FILE *fptr;
+    unsigned char *prefix;          // bytes the caller already read
+    size_t prefixLen, prefixUsed;
+    unsigned long long pos;         // bytes of the file consumed so far
+    UCFileHeader head;
+    UCFileChunk *table;
+    unsigned long long chunk;       // the next chunk to load
+    unsigned char *data;            // the raw bytes of the chunk
+    unsigned char *symbols;         // and its symbols
+    unsigned long long have, used;
+    int failed;
+};
+
+// Read len bytes of the file into out (or skip them if out is NULL), 
+// the prefix comes first. Returns 0 if the file ended early
+static int streamBytes(UCFileStream *s, void *out, size_t len){
+    unsigned char *dst = out;
+    size_t take = s->prefixLen - s->prefixUsed < len ? s->prefixLen - s->prefixUsed : len;
+    if (dst) memcpy(dst, s->prefix + s->prefixUsed, take);
+    s->prefixUsed += take;
+    s->pos += take;
+
+    for (size_t done = take; done < len; ){
+        unsigned char skip[4096];
+        size_t want = len - done;
+        if (!dst && want > sizeof(skip)) want = sizeof(skip);
+        size_t got = fread(dst ? dst + done : skip, 1, want, s->fptr);
+        if (got == 0) return 0;
+        done += got;
+        s->pos += got;
+    }
+    return 1;
+}
+
+// Whether bytes read from the start of a stream look like a container
+int ucfile_is_container(const unsigned char *prefix, size_t prefixLen){
+    return prefixLen >= 8 && memcmp(prefix, UCF_MAGIC, 8) == 0;
+}
+
+// The n of the container whose first prefixLen bytes are in prefix, or 
+// 0 if they don't hold a valid header
+int ucfile_header_n(const unsigned char *prefix, size_t prefixLen){
+    UCFileHeader head;
+    if (prefixLen < sizeof(head)) return 0;
+    memcpy(&head, prefix, sizeof(head));
+    return validHeader(&head) ? (int)head.n : 0;
+}
+
+// Start reading a container from fptr. The first prefixLen bytes of the
+// file may already have been read (say while telling a container apart
+// from a text cycle) and are handed over in prefix. Returns NULL if the
+// header or the chunk table is not valid
+UCFileStream * ucfile_stream_open(FILE *fptr, const unsigned char *prefix, size_t prefixLen){
+    UCFileStream *s = calloc(1, sizeof(UCFileStream));
+    if (!s) return NULL;
+    s->fptr = fptr;
+    s->prefixLen = prefixLen;
+    s->prefix = malloc(prefixLen ? prefixLen : 1);
+    if (!s->prefix){
+        free(s);
+        return NULL;
+    }
+    memcpy(s->prefix, prefix, prefixLen);
+
+    int ok = streamBytes(s, &s->head, sizeof(UCFileHeader)) && validHeader(&s->head);
+    if (ok){
+        s->table = malloc(s->head.chunks * sizeof(UCFileChunk));
+        ok = s->table && streamBytes(s, s->table, s->head.chunks * sizeof(UCFileChunk));
+    }
+
+    // No chunk can be bigger than its packed symbols, or its checkpoint 
+    // and bits, rounded up to whole words
+    unsigned long long most = s->head.payload == UCF_SN_BITS ? SN_CHECKPOINT + s->head.chunkSymbols / 8
+                                                             : s->head.chunkSymbols * s->head.bits / 8;
+    for (unsigned long long c = 0; ok && c < s->head.chunks; c++) ok = s->table[c].bytes == chunkBytes(&s->head, c);
+    if (ok){
+        s->data = calloc(most + 8, 1);
+        s->symbols = malloc(s->head.chunkSymbols);
+        ok = s->data && s->symbols;
+    }
+    if (!ok){
+        fprintf(stderr, "Error not a universal cycle container\n");
+        ucfile_stream_close(s);
+        return NULL;
+    }
+    return s;
+}
+
+int ucfile_stream_n(const UCFileStream *s){ return s->head.n; }
+unsigned long long ucfile_stream_length(const UCFileStream *s){ return s->head.length; }
+// The bytes of the file consumed so far
+unsigned long long ucfile_stream_bytes(const UCFileStream *s){
+    return s->pos;
+}
+
+int ucfile_stream_failed(const UCFileStream *s){ return s->failed; }
+
+// Load, check and decode the next chunk
+static int streamChunk(UCFileStream *s){
+    const UCFileChunk *c = &s->table[s->chunk];
+    if (c->offset < s->pos || !streamBytes(s, NULL, c->offset - s->pos) || !streamBytes(s, s->data, c->bytes)){
+        fprintf(stderr, "Error chunk %llu is missing\n", s->chunk);
+        return 0;
+    }
+    if (crc32c(0, s->data, c->bytes) != c->crc){
+        fprintf(stderr, "Error chunk %llu fails its checksum\n", s->chunk);
+        return 0;
+    }
+
+    unsigned long long first = s->chunk * s->head.chunkSymbols;
+    s->have = s->head.length - first < s->head.chunkSymbols ? s->head.length - first : s->head.chunkSymbols;
+    s->used = 0;
+    if (s->head.payload == UCF_SN_BITS){
+        int perm[maxN];
+        for (unsigned int i = 0; i < s->head.n; i++) perm[i] = s->data[i];
+        expandSnBits(s->head.n, perm, (const unsigned long long *)(s->data + SN_CHECKPOINT), s->have, s->symbols);
+    }
+    else{
+        UCBuffer view = { UC_PACKED, s->head.bits, s->have, s->data };
+        for (unsigned long long i = 0; i < s->have; i++) s->symbols[i] = getSymbol(&view, i);
+    }
+    s->chunk++;
+    return 1;
+}
+
+// Copy the next (up to) len symbols of the cycle into buf. Returns the
+// number copied, 0 once the cycle has been read or a chunk could not be
+// read or fails its checksum (ucfile_stream_failed tells which)
+unsigned long long ucfile_stream_read(UCFileStream *s, unsigned char *buf, unsigned long long len){
+    unsigned long long done = 0;
+    while (done < len && !s->failed){
+        if (s->used == s->have){
+            if (s->chunk == s->head.chunks) break;
+            if (!streamChunk(s)){
+                s->failed = 1;
+                break;
+            }
+        }
+        unsigned long long take = s->have - s->used < len - done ? s->have - s->used : len - done;
+        memcpy(buf + done, s->symbols + s->used, take);
+        s->used += take;
+        done += take;
+    }
+    return done;
+}
+
+// Free the stream, the FILE is left open
+void ucfile_stream_close(UCFileStream *s){
+    if (!s) return;
+    free(s->prefix);
+    free(s->table);
+    free(s->data);
+    free(s->symbols);
+    free(s);
+}
@@ -0,0 +1,1186 @@
+#define _DEFAULT_SOURCE
+#include "constructAndRank.h"
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Return 1 if U[0..] of length n! is a valid shorthand U‑cycle for Π(n), 0 otherwise
+int isUniversalCycle(int *U, unsigned long long L, int n){
+  // Wrap the int array so it can be read through the buffer accessors
+  UCBuffer uc = { UC_INT, 0, L, U };
+  return isUniversalCycleBuffer(&uc, n);
+}
+
+// Return 1 if the symbols in uc (stored in any of the buffer modes) form
+// a valid shorthand U‑cycle for Π(n), 0 otherwise. The symbols are read
+// straight from the buffer so packed cycles never have to be expanded
+int isUniversalCycleBuffer(const UCBuffer *uc, int n){
+  unsigned long long L = uc->len;
+  unsigned long long len = factorial(n);
+  // If the length of U is not equal to n! then it cannot be a universal cycle
+  if (len != L) return 0;
+  //printf("L = %llu, n! = %llu, n = %d\n", L, len,n);
+
+  // Can be used to select the ranking algorithm
+  // 3 for the sliding window 7-order, 2 for 7-order, 1 for Lehmer code, 
+  // 0 for Ruskey-Williams
+  int algo = 3;
+  if (algo == 3 && n >= 3) return isUniversalCycleSliding(uc, n);
+
+  // To keep track of which ranks we've seen
+  char *seen = malloc(L * sizeof(char));
+  if (!seen) {
+      fprintf(stderr, "Error memory allocation failed\n");
+      return 0;
+  }
+  memset(seen, 0, L * sizeof(char));
+
+
+  // Loop through the universal cycle U and compute the rank of each
+  // substring of length n-1 starting at index i
+  // If the rank is invalid or we have seen this rank before
+  // then the given string is not a universal cycle
+  for (unsigned long long i = 0; i < L; i++) {
+    // Call a ranking function
+    long long rank;
+    if (algo == 2){
+      // If we are using the 7-order ranking algorithm then we need to
+      // create a permutation of length n before we call the ranking 
+      // algorithm. This means that we will have to find the missing 
+      // symbol in the current substring of of length n-1 and append it
+      // to the end of the substring to create a full permutation of length n
+
+      // Copy the current substring of length n-1 into a permutation
+      // and compute the sum of the symbols in the substring
+      int perm[n], sum = 0;
+      for (int j = 0; j < n-1; j++){ 
+        perm[j] = getSymbol(uc, (i+j) % L);
+        sum += perm[j];
+      }
+      // Find the missing symbol 1..n in the permutation using 
+      // the fact that ∑n = n(n+1)/2 and ∑perm = ∑n - missing
+      // So missing = ∑n - ∑perm
+      int missing = (n * (n + 1) / 2) - sum;
+      perm[n-1] = missing;
+
+      // Now that we have constructed the full permutation we can compute its rank
+      rank = rank7OrderFast(perm, n);
+      
+    }
+
+    else if (algo == 1) rank = rankLehmerBuffer(uc, n, i);
+    else{
+      // If we are using the Ruskey-Williams algorithm then we need to
+      // create a permutation of length n before we call the ranking 
+      // algorithm. This means that we will have to find the missing 
+      // symbol in the current substring of of length n-1 and append it
+      // to the end of the substring to create a full permutation of length n
+
+      // Copy the current substring of length n-1 into a permutation
+      // and compute the sum of the symbols in the substring
+      int perm[n], sum = 0;
+      for (int j = 0; j < n-1; j++){ 
+        perm[j] = getSymbol(uc, (i+j) % L);
+        sum += perm[j];
+      }
+      // Find the missing symbol 1..n in the permutation using 
+      // the fact that ∑n = n(n+1)/2 and ∑perm = ∑n - missing
+      // So missing = ∑n - ∑perm
+      int missing = (n * (n + 1) / 2) - sum;
+      perm[n-1] = missing;
+
+      // Now that we have constructed the full permutation we can compute its rank
+      rank = rankRuskeyWilliamsFast(perm, n);
+    }
+    
+    //printf("rank %d\n", rank);
+
+    // If the rank is invalid or we have seen this rank before
+    // then the given string is not a universal cycle
+    if (rank < 0 || rank >= L || seen[rank]){
+        free(seen);
+        return 0;
+    }
+    // Otherwise mark this rank as seen and continue
+    seen[rank] = 1;
+  }
+  // If we have seen all ranks from 0 to n! - 1 then the given string is a universal cycle
+  free(seen);
+  return 1;
+}
+  
+// Sliding window verification. Neighbouring windows of a universal cycle
+// share n-2 symbols and the permutation of window i+1 is always σₙ or
+// σₙ₋₁ of the permutation of window i (the symbol coming in is either the
+// missing one or the one going out, anything else is a repeated symbol).
+// Both rotations change the 7-order digits in a simple way so the rank
+// is updated as the window slides instead of being recomputed:
+//
+//   σₙ   : offset[s] += 1 (mod s) for every s ≥ p0
+//   σₙ₋₁ : the same except offset[m] is unchanged and offset[p0] goes
+//          up by 2 if m < p0
+//
+// where p0 is the first symbol of the window and m the missing one.
+// Any window can be ranked from scratch and slid from there, so the
+// windows are split into ranges that are verified on their own threads.
+// They share one bitmap of the ranks seen so far, updated with atomic
+// fetch-or, and a stop flag that ends every range as soon as one of
+// them finds a repeated or invalid window.
+//
+// The ranks are effectively random so once the bitmap is larger than the
+// cache every mark is a miss to DRAM. In partitioned mode the ranks of a
+// block are instead scattered by their high bits into buckets that each
+// cover a slice of the bitmap, and a bucket is only marked into its slice
+// once it is full. The misses are then paid once per slice line rather 
+// than once per window. The slices are at least 2^PART_SLICE_BITS ranks
+// (256 KB) and grow so there are never more than PART_MAX_BUCKETS 
+// buckets, so the lines being filled stay in cache and their pages in 
+// the TLB (n = 13 has 1 MB slices, n = 14 16 MB). The mode is opt-in, 
+// on a 1 core AVX2 machine with a 300 MB L3 it measured 0.8x to 1.1x of
+// direct marking for n = 10..12 and 0.93x for n = 13, where ranking the
+// windows and not the marks is the cost
+
+#define SLIDE_BLOCK (1 << 14)
+#define PART_SLICE_BITS 21
+#define PART_MAX_BUCKETS 1024
+#define PART_BUDGET (32ull << 20)
+#define PART_PREFETCH 16
+#define STREAM_BUFFER (1 << 16)
+#define STREAM_PEEK 4096
+
+// One range of windows to verify, the symbols come either from a buffer
+// or from the characters of a UC text file ('0'-'9' then A,B,C...)
+typedef struct {
+    const UCBuffer *uc;
+    const unsigned char *text;
+    unsigned long long len;         // symbols in the whole cycle
+    int n;
+    int threads;                    // threads sharing the bitmap
+    _Atomic unsigned long long *seen;
+    atomic_int *stop;
+    unsigned long long from, to;    // windows from..to-1
+    int partitioned;
+} VerifyRange;
+
+// The sliding 7-order rank of the current window
+typedef struct {
+    int n;
+    int m;                          // the symbol missing from the window
+    int offset[maxN + 1];
+    long long weight[maxN + 1];     // n!/s!
+    long long rank;
+} Slider;
+
+// The bucket buffers of a thread in partitioned mode, bucket b holds the
+// low bits of ranks in [b << shift, (b + 1) << shift)
+typedef struct {
+    int shift;
+    unsigned long long buckets;
+    unsigned int capacity;
+    unsigned int *fill;
+    unsigned int *data;             // bucket b starts at data + b * capacity
+} Partition;
+
+// Add d to the digit of s and keep the rank in step, weight[s] is n!/s!
+static inline void bumpDigit(int *offset, const long long *weight, long long *rank, int s, int d){
+    int o = offset[s] + d;
+    if (o >= s) o -= s;
+    *rank += (o - offset[s]) * weight[s];
+    offset[s] = o;
+}
+
+// Map a character of the text format to its symbol, anything that is 
+// not a symbol character becomes 0 which is never a valid symbol
+static inline unsigned char textSymbol(unsigned char c){
+    return (c >= '0' && c <= '9') ? c - '0' : (c >= 'A' && c <= 'Z') ? c - 'A' + 10 : 0;
+}
+
+// Copy the symbols first..first+len-1 into out, wrapping around the end
+// of the cycle
+static void stageSymbols(const VerifyRange *v, unsigned long long first, unsigned long long len, unsigned char *out){
+    for (unsigned long long t = 0; t < len; ){
+        unsigned long long i = (first + t) % v->len;
+        unsigned long long run = v->len - i < len - t ? v->len - i : len - t;
+        if (v->text) for (unsigned long long u = 0; u < run; u++) out[t + u] = textSymbol(v->text[i + u]);
+        else if (v->uc->mode == UC_BYTE) memcpy(out + t, (unsigned char *)v->uc->data + i, run);
+        else for (unsigned long long u = 0; u < run; u++) out[t + u] = getSymbol(v->uc, i + u);
+        t += run;
+    }
+}
+
+// Mark rank as seen, returns 0 if it had been seen already
+static inline int markRank(const VerifyRange *v, long long rank){
+    unsigned long long bit = 1ull << (rank & 63);
+    _Atomic unsigned long long *word = v->seen + (rank >> 6);
+    if (v->threads > 1) return !(atomic_fetch_or_explicit(word, bit, memory_order_relaxed) & bit);
+
+    unsigned long long old = atomic_load_explicit(word, memory_order_relaxed);
+    atomic_store_explicit(word, old | bit, memory_order_relaxed);
+    return !(old & bit);
+}
+
+// Rank the window of n-1 symbols from scratch, returns 0 if it is not 
+// n-1 distinct symbols of 1..n
+static int sliderInit(Slider *sl, int n, const unsigned char *window){
+    sl->n = n;
+    sl->weight[n] = 1;
+    for (int s = n - 1; s >= 1; s--) sl->weight[s] = sl->weight[s + 1] * (s + 1);
+
+    int perm[maxN];
+    sl->m = n * (n + 1) / 2;
+    for (int t = 0; t < n - 1; t++){
+        perm[t] = window[t];
+        sl->m -= perm[t];
+    }
+    perm[n - 1] = sl->m;
+    memset(sl->offset, 0, sizeof(sl->offset));
+    if (!rank7OrderDigits(perm, n, sl->offset)) return 0;
+
+    sl->rank = 0;
+    for (int s = 2; s <= n; s++) sl->rank += sl->offset[s] * sl->weight[s];
+    return 1;
+}
+
+// Write the ranks of the len windows starting at sym into ranks, sliding
+// one symbol at a time. sym holds len + n - 1 symbols. Returns 0 as soon
+// as a window is not a permutation
+static int slideRanks(Slider *sl, const unsigned char *sym, unsigned long long len, long long *ranks){
+    int n = sl->n, m = sl->m, *offset = sl->offset;
+    const long long *weight = sl->weight;
+    long long rank = sl->rank;
+
+    for (unsigned long long t = 0; t < len; t++){
+        ranks[t] = rank;
+
+        // Slide to the next window, p0 leaves and x comes in
+        int p0 = sym[t], x = sym[t + n - 1];
+        int skip = 0;
+        if (x == p0) skip = m;         // σₙ₋₁, m stays missing
+        else if (x != m) return 0;
+        for (int s = p0 + 1; s <= n; s++) if (s != skip) bumpDigit(offset, weight, &rank, s, 1);
+        bumpDigit(offset, weight, &rank, p0, (skip && m < p0) ? 2 : 1);
+        if (!skip) m = p0;              // σₙ, p0 is the missing one now
+    }
+
+    sl->m = m;
+    sl->rank = rank;
+    return 1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// slideRanks with all the digits in the byte lanes of one AVX2 register
+// (lane s holds offset[s]) so a slide is a handful of vector operations
+// instead of a loop over s ≥ p0 whose length changes every window. The 
+// rank moves by the weights of the digits that went up, which is a 
+// suffix sum of the weights, less s·weight[s] for each digit that 
+// wrapped around. The wrapped digits come out as a bit mask which is 
+// turned into that sum with a table per byte of the mask, looping over
+// the bits instead mispredicts on most windows
+__attribute__((target("avx2")))
+static int slideRanksAVX2(Slider *sl, const unsigned char *sym, unsigned long long len, long long *ranks){
+    int n = sl->n, m = sl->m;
+    long long rank = sl->rank;
+
+    // gain[p] = Σ weight[s] for s ≥ p, what the rank goes up by when 
+    // the digits from p on go up by 1. wrap[k][bits] = Σ s·weight[s] 
+    // over the s = 8k + i with bit i set
+    long long weight[maxN + 1], gain[maxN + 2];
+    long long wrap[3][256];
+    weight[0] = 0;
+    for (int s = 1; s <= n; s++) weight[s] = sl->weight[s];
+    gain[n + 1] = 0;
+    for (int s = n; s >= 1; s--) gain[s] = gain[s + 1] + weight[s];
+    for (int k = 0; k < 3; k++){
+        for (int bits = 0; bits < 256; bits++){
+            wrap[k][bits] = 0;
+            for (int i = 0; i < 8; i++){
+                int s = 8 * k + i;
+                if ((bits >> i) & 1 && s >= 1 && s <= n) wrap[k][bits] += s * weight[s];
+            }
+        }
+    }
+
+    unsigned char lanes[32], limit[32], digits[32] = {0};
+    for (int s = 0; s < 32; s++){
+        lanes[s] = s;
+        limit[s] = (s >= 1 && s <= n) ? s - 1 : 127;
+        if (s <= n) digits[s] = sl->offset[s];
+    }
+    __m256i idx = _mm256_loadu_si256((__m256i *)lanes);
+    __m256i top = _mm256_loadu_si256((__m256i *)limit);
+    __m256i live = _mm256_cmpgt_epi8(_mm256_set1_epi8(n + 1), idx);
+    __m256i o = _mm256_loadu_si256((__m256i *)digits);
+
+    for (unsigned long long t = 0; t < len; t++){
+        ranks[t] = rank;
+
+        // Everything below is worked out without branches, which rotation
+        // comes next is as good as random
+        int p0 = sym[t], x = sym[t + n - 1];
+        if ((x != p0) & (x != m)) return 0;
+        int rotate = x == p0;           // σₙ₋₁, m stays missing
+        int skip = m & -rotate;
+        int twice = rotate & (m < p0);
+
+        // +1 on every s > p0 other than skip, +1 or +2 on p0
+        __m256i up = _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(p0)), live);
+        up = _mm256_andnot_si256(_mm256_cmpeq_epi8(idx, _mm256_set1_epi8(skip)), up);
+        __m256i inc = _mm256_sub_epi8(_mm256_setzero_si256(), up);
+        inc = _mm256_add_epi8(inc, _mm256_and_si256(_mm256_cmpeq_epi8(idx, _mm256_set1_epi8(p0)), _mm256_set1_epi8(1 + twice)));
+        o = _mm256_add_epi8(o, inc);
+        rank += gain[p0] + (weight[p0] & -(long long)twice) - (weight[skip] & -(long long)(skip > p0));
+
+        // Digits that reached s go back down by s
+        __m256i wrapped = _mm256_cmpgt_epi8(o, top);
+        o = _mm256_sub_epi8(o, _mm256_and_si256(wrapped, idx));
+        unsigned int bits = _mm256_movemask_epi8(wrapped);
+        rank -= wrap[0][bits & 255] + wrap[1][(bits >> 8) & 255] + wrap[2][(bits >> 16) & 255];
+
+        m ^= (m ^ p0) & (rotate - 1);   // σₙ, p0 is the missing one now
+    }
+
+    _mm256_storeu_si256((__m256i *)digits, o);
+    for (int s = 0; s <= n; s++) sl->offset[s] = digits[s];
+    sl->m = m;
+    sl->rank = rank;
+    return 1;
+}
+#endif
+
+// Slide with the fastest version the CPU supports
+static int slide(Slider *sl, const unsigned char *sym, unsigned long long len, long long *ranks){
+#if defined(__x86_64__) || defined(__i386__)
+    if (useSIMD && __builtin_cpu_supports("avx2")) return slideRanksAVX2(sl, sym, len, ranks);
+#endif
+    return slideRanks(sl, sym, len, ranks);
+}
+
+// Mark the ranks held in bucket b into its slice of the bitmap and empty
+// it, returns 0 if one of them had been seen already
+static int flushBucket(const VerifyRange *v, Partition *part, unsigned long long b){
+    const unsigned int *low = part->data + b * part->capacity;
+    long long base = (long long)b << part->shift;
+    int ok = 1;
+    for (unsigned int i = 0; i < part->fill[b]; i++) ok &= markRank(v, base + low[i]);
+    part->fill[b] = 0;
+    return ok;
+}
+
+// Scatter the ranks into their buckets, flushing any bucket that fills.
+// The slot the next rank of a bucket goes into is prefetched for writing
+// so the scatter itself does not stall. Returns 0 on a repeated rank
+static int partitionRanks(const VerifyRange *v, Partition *part, const long long *ranks, unsigned long long len){
+    for (unsigned long long t = 0; t < len; t++){
+        // Fetch the slot of the rank PART_PREFETCH ahead so its miss 
+        // overlaps with the work on the ranks in between
+        if (t + PART_PREFETCH < len){
+            unsigned long long ahead = ranks[t + PART_PREFETCH] >> part->shift;
+            __builtin_prefetch(part->data + ahead * part->capacity + part->fill[ahead], 1);
+        }
+
+        unsigned long long b = ranks[t] >> part->shift;
+        unsigned int *slot = part->data + b * part->capacity + part->fill[b];
+        *slot = ranks[t] & ((1ull << part->shift) - 1);
+        if (++part->fill[b] == part->capacity && !flushBucket(v, part, b)) return 0;
+    }
+    return 1;
+}
+
+// Verify the windows of one range, sets the stop flag if one of them is
+// repeated or is not a permutation
+static void * verifyRange(void *arg){
+    VerifyRange *v = arg;
+    int n = v->n;
+    unsigned char *sym = malloc(SLIDE_BLOCK + n);
+    long long *ranks = malloc(SLIDE_BLOCK * sizeof(long long));
+
+    // Split the budget for bucket buffers between the threads, but give
+    // every bucket at least 1024 slots. The low bits of a rank have to
+    // fit in a slot, past n = 15 the ranks are just marked directly
+    Partition part = { PART_SLICE_BITS };
+    while (((v->len - 1) >> part.shift) + 1 > PART_MAX_BUCKETS) part.shift++;
+    if (part.shift > 32) v->partitioned = 0;
+    if (v->partitioned){
+        part.buckets = ((v->len - 1) >> part.shift) + 1;
+        unsigned long long capacity = PART_BUDGET / sizeof(unsigned int) / part.buckets / v->threads;
+        part.capacity = capacity < 1024 ? 1024 : capacity > (1u << 16) ? (1u << 16) : capacity;
+        part.fill = calloc(part.buckets, sizeof(unsigned int));
+        part.data = malloc(part.buckets * part.capacity * sizeof(unsigned int));
+    }
+    if (!sym || !ranks || (v->partitioned && (!part.fill || !part.data))){
+        fprintf(stderr, "Error memory allocation failed\n");
+        atomic_store(v->stop, 1);
+        free(sym);
+        free(ranks);
+        free(part.fill);
+        free(part.data);
+        return NULL;
+    }
+
+    // Rank the first window of the range from scratch
+    Slider sl;
+    stageSymbols(v, v->from, n - 1, sym);
+    int ok = sliderInit(&sl, n, sym);
+
+    for (unsigned long long base = v->from; ok && base < v->to; base += SLIDE_BLOCK){
+        if (atomic_load_explicit(v->stop, memory_order_relaxed)) break;
+        unsigned long long len = v->to - base < SLIDE_BLOCK ? v->to - base : SLIDE_BLOCK;
+        stageSymbols(v, base, len + n - 1, sym);
+
+        ok = slide(&sl, sym, len, ranks);
+        if (ok && v->partitioned) ok = partitionRanks(v, &part, ranks, len);
+        else for (unsigned long long t = 0; ok && t < len; t++) ok = markRank(v, ranks[t]);
+    }
+    for (unsigned long long b = 0; ok && b < part.buckets; b++) ok = flushBucket(v, &part, b);
+
+    if (!ok) atomic_store(v->stop, 1);
+    free(sym);
+    free(ranks);
+    free(part.fill);
+    free(part.data);
+    return NULL;
+}
+
+// Verify the L symbols from uc or text on the given number of threads
+// in direct or partitioned mode
+static int verifyWindows(const UCBuffer *uc, const unsigned char *text, unsigned long long L, int n, int threads, int partitioned){
+    if (n < 3 || n > maxN || L != factorial(n)) return 0;
+    if (threads < 1) threads = 1;
+    if ((unsigned long long)threads > L) threads = L;
+
+    _Atomic unsigned long long *seen = calloc((L + 63) / 64, sizeof(unsigned long long));
+    pthread_t *tid = malloc(threads * sizeof(pthread_t));
+    VerifyRange *ranges = malloc(threads * sizeof(VerifyRange));
+    int *started = calloc(threads, sizeof(int));
+    if (!seen || !tid || !ranges || !started){
+        fprintf(stderr, "Error memory allocation failed\n");
+        free(seen);
+        free(tid);
+        free(ranges);
+        free(started);
+        return 0;
+    }
+
+    atomic_int stop;
+    atomic_init(&stop, 0);
+    for (int t = 0; t < threads; t++)
+        ranges[t] = (VerifyRange){ uc, text, L, n, threads, seen, &stop, L * t / threads, L * (t + 1) / threads, partitioned };
+
+    // The first range runs on this thread, and so does any range we
+    // cannot get another thread for
+    for (int t = 1; t < threads; t++){
+        started[t] = pthread_create(&tid[t], NULL, verifyRange, &ranges[t]) == 0;
+        if (!started[t]) verifyRange(&ranges[t]);
+    }
+    verifyRange(&ranges[0]);
+    for (int t = 1; t < threads; t++) if (started[t]) pthread_join(tid[t], NULL);
+
+    int ok = !atomic_load(&stop);
+    free(started);
+    free(seen);
+    free(tid);
+    free(ranges);
+    return ok;
+}
+
+// Return 1 if the symbols in uc form a valid shorthand U‑cycle for Π(n),
+// 0 otherwise. Gives the same answer as isUniversalCycleBuffer but each
+// window costs O(n - p0) additions instead of a full ranking. The
+// symbols are staged a block at a time together with the n-1 that follow
+// it (copied around the end of the cycle) so the loop itself never wraps
+int isUniversalCycleSliding(const UCBuffer *uc, int n){
+    if (n < 3) return isUniversalCycleBuffer(uc, n);
+    return verifyWindows(uc, NULL, uc->len, n, 1, 0);
+}
+
+// Same as isUniversalCycleSliding with the windows split across the
+// given number of threads
+int isUniversalCycleParallel(const UCBuffer *uc, int n, int threads){
+    if (n < 3) return isUniversalCycleBuffer(uc, n);
+    return verifyWindows(uc, NULL, uc->len, n, threads, 0);
+}
+
+// Same as isUniversalCycleParallel but the ranks are radix partitioned 
+// into buckets that each cover a cache sized slice of the bitmap before
+// they are marked
+int isUniversalCyclePartitioned(const UCBuffer *uc, int n, int threads){
+    if (n < 3) return isUniversalCycleBuffer(uc, n);
+    return verifyWindows(uc, NULL, uc->len, n, threads, 1);
+}
+
+// Verify the UC text file at path (as written by '-f', '0'-'9' and then
+// A,B,C... from 10 onwards) for Π(n) on the given number of threads. The
+// file is mapped and read in place rather than loaded into memory first,
+// a trailing newline is ignored. Returns 1 if it holds a valid universal
+// cycle, 0 if not and -1 if it could not be read
+int verifyUCFile(const char *path, int n, int threads){
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0){
+        fprintf(stderr, "Error opening %s\n", path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    unsigned long long size = st.st_size;
+    if (size == 0){
+        close(fd);
+        return 0;
+    }
+    unsigned char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED){
+        fprintf(stderr, "Error mapping %s\n", path);
+        return -1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    unsigned long long L = size;
+    while (L > 0 && (map[L - 1] == '\n' || map[L - 1] == '\r')) L--;
+
+    int ok;
+    if (n < 3){
+        // Too short to be worth threads, decode it into a buffer
+        UCBuffer *uc = newUCBuffer(n, L, UC_BYTE);
+        ok = uc != NULL;
+        for (unsigned long long i = 0; ok && i < L; i++)
+            ((unsigned char *)uc->data)[i] = map[i] >= '0' && map[i] <= '9' ? map[i] - '0' : 0;
+        ok = ok && isUniversalCycleBuffer(uc, n);
+        freeUCBuffer(uc);
+    }
+    else ok = verifyWindows(NULL, map, L, n, threads, 0);
+
+    munmap(map, size);
+    return ok;
+}
+
+// Streaming verification of a cycle that arrives a piece at a time. Only
+// the current window and the first n-2 symbols (to close the cycle at 
+// the end) are kept besides the bitmap, so a cycle far bigger than 
+// memory can be piped straight in. The bitmap can cover just a range
+// of the ranks, so a cycle whose bitmap does not fit in memory can be
+// verified in several passes over it
+struct UCVerifier {
+    int n;
+    int ok;
+    unsigned long long length;      // n!
+    unsigned long long count;       // symbols fed so far
+    unsigned long long lo, hi;      // the ranks the bitmap covers
+    unsigned long long marked;      // ranks marked in lo..hi-1
+    unsigned char first[maxN];      // the first n-1 symbols
+    unsigned char *stage;           // the window and then the next block
+    long long *ranks;
+    Slider sl;
+    VerifyRange v;                  // for markRank
+};
+
+// Start verifying a cycle for Π(n). Returns NULL if n is out of range or
+// the bitmap could not be allocated
+UCVerifier * ucv_open(int n){
+    return ucv_open_range(n, 0, ~0ull);
+}
+
+// Start verifying a cycle for Π(n) but only keep track of the ranks in
+// lo..hi-1 (hi is capped at n!), so the bitmap takes (hi-lo)/8 bytes. 
+// ucv_finish then says whether those ranks each appear exactly once, and
+// the cycle is valid if that holds for every range in a partition of 
+// 0..n!-1
+UCVerifier * ucv_open_range(int n, unsigned long long lo, unsigned long long hi){
+    if (n < 1 || n > maxN) return NULL;
+    UCVerifier *uv = calloc(1, sizeof(UCVerifier));
+    if (!uv) return NULL;
+
+    uv->n = n;
+    uv->ok = 1;
+    uv->length = factorial(n);
+    uv->hi = hi < uv->length ? hi : uv->length;
+    uv->lo = lo < uv->hi ? lo : uv->hi;
+    uv->stage = malloc(SLIDE_BLOCK + n);
+    uv->ranks = malloc(SLIDE_BLOCK * sizeof(long long));
+    uv->v.seen = calloc((uv->hi - uv->lo + 63) / 64 + 1, sizeof(unsigned long long));
+    uv->v.threads = 1;
+    if (!uv->stage || !uv->ranks || !uv->v.seen){
+        fprintf(stderr, "Error memory allocation failed\n");
+        ucv_close(uv);
+        return NULL;
+    }
+    return uv;
+}
+
+// Mark a rank if it is in the range the bitmap covers
+static inline void ucvMark(UCVerifier *uv, long long rank){
+    unsigned long long r = rank - uv->lo;
+    if (r < uv->hi - uv->lo){
+        uv->ok = markRank(&uv->v, r);
+        uv->marked++;
+    }
+}
+
+// Slide the window over the next len symbols, marking the rank of each
+// window the window leaves behind
+static void ucvSlide(UCVerifier *uv, const unsigned char *sym, unsigned long long len){
+    int n = uv->n;
+    while (uv->ok && len > 0){
+        unsigned long long take = len < SLIDE_BLOCK ? len : SLIDE_BLOCK;
+        memcpy(uv->stage + n - 1, sym, take);
+        uv->ok = slide(&uv->sl, uv->stage, take, uv->ranks);
+        for (unsigned long long t = 0; uv->ok && t < take; t++) ucvMark(uv, uv->ranks[t]);
+
+        // The last n-1 symbols are the new window
+        memmove(uv->stage, uv->stage + take, n - 1);
+        sym += take;
+        len -= take;
+    }
+}
+
+// Feed the next len symbols of the cycle (as values 1..n). Returns 0 
+// once the cycle is known not to be valid, there is no need to feed 
+// the rest of it after that
+int ucv_feed(UCVerifier *uv, const unsigned char *sym, unsigned long long len){
+    int n = uv->n;
+    if (!uv->ok) return 0;
+    if (len > uv->length - uv->count){
+        uv->ok = 0;
+        return 0;
+    }
+
+    // The first n-1 symbols are kept and make the first window, for n < 3
+    // the whole cycle is kept instead
+    unsigned long long keep = n < 3 ? uv->length : (unsigned long long)n - 1;
+    while (len > 0 && uv->count < keep){
+        uv->first[uv->count++] = *sym++;
+        len--;
+        if (uv->count == keep && n >= 3){
+            uv->ok = sliderInit(&uv->sl, n, uv->first);
+            memcpy(uv->stage, uv->first, n - 1);
+        }
+    }
+
+    if (n >= 3) ucvSlide(uv, sym, len);
+    uv->count += len;
+    return uv->ok;
+}
+
+// Finish once the whole cycle has been fed. The windows that wrap around
+// the end are slid over the first n-2 symbols again. Returns 1 if the 
+// symbols fed form a valid shorthand U‑cycle for Π(n), 0 otherwise
+int ucv_finish(UCVerifier *uv){
+    int n = uv->n;
+    if (!uv->ok || uv->count != uv->length) return 0;
+    if (n < 3){
+        // The whole cycle fits in first[]
+        int U[maxN];
+        for (int i = 0; i < (int)uv->length; i++) U[i] = uv->first[i];
+        return isUniversalCycle(U, uv->length, n);
+    }
+
+    ucvSlide(uv, uv->first, n - 2);
+    if (uv->ok) ucvMark(uv, uv->sl.rank);
+
+    // With no rank seen twice, every rank in the range is seen if there 
+    // were as many marks as ranks
+    return uv->ok && uv->marked == uv->hi - uv->lo;
+}
+
+void ucv_close(UCVerifier *uv){
+    if (!uv) return;
+    free(uv->stage);
+    free(uv->ranks);
+    free(uv->v.seen);
+    free(uv);
+}
+
+// Verify the ranks lo..hi-1 of the cycle read from fptr, either a 
+// container (recognised by its magic) or text as written by outputUC. 
+// The text may come straight from run, anything up to the last ": " on
+// its first line (the "Enter n: UC: " prompts) is skipped and the cycle
+// ends at the first newline. *n is only needed for text, for a container
+// it is set from the header. The first prefixLen (≤ STREAM_BUFFER) bytes
+// may already have been read into prefix. *bytes is set to the bytes 
+// read. Returns 1 if the ranks each appear once, 0 if not and -1 if it 
+// could not be read
+static int verifyStreamRange(FILE *fptr, const unsigned char *prefix, size_t prefixLen, int *n, 
+                             unsigned long long lo, unsigned long long hi, unsigned long long *bytes){
+    unsigned char *buf = malloc(STREAM_BUFFER);
+    if (!buf){
+        fprintf(stderr, "Error memory allocation failed\n");
+        return -1;
+    }
+    if (prefixLen) memcpy(buf, prefix, prefixLen);
+    size_t got = prefixLen + fread(buf + prefixLen, 1, STREAM_BUFFER - prefixLen, fptr);
+    UCVerifier *uv = NULL;
+    int ok = -1;
+
+    *bytes = got;
+    if (ucfile_is_container(buf, got)){
+        UCFileStream *s = ucfile_stream_open(fptr, buf, got);
+        if (s){
+            *n = ucfile_stream_n(s);
+            uv = ucv_open_range(*n, lo, hi);
+        }
+        if (uv){
+            unsigned long long len;
+            while ((len = ucfile_stream_read(s, buf, STREAM_BUFFER)) > 0 && ucv_feed(uv, buf, len));
+            ok = ucfile_stream_failed(s) ? -1 : ucv_finish(uv);
+            if (ucfile_stream_bytes(s) > *bytes) *bytes = ucfile_stream_bytes(s);
+        }
+        ucv_close(uv);
+        ucfile_stream_close(s);
+        free(buf);
+        return ok;
+    }
+
+    if (*n < 1 || *n > maxN) fprintf(stderr, "Error n is needed to verify a text cycle\n");
+    else uv = ucv_open_range(*n, lo, hi);
+    if (!uv){
+        free(buf);
+        return -1;
+    }
+
+    // Skip the prompts on the first line
+    size_t start = 0;
+    for (size_t i = 0; i + 1 < got && buf[i] != '\n'; i++) if (buf[i] == ':' && buf[i + 1] == ' ') start = i + 2;
+
+    int done = 0;
+    while (!done && got > 0){
+        size_t len = 0;
+        for (size_t i = start; i < got; i++){
+            if (buf[i] == '\n' || buf[i] == '\r'){
+                done = 1;
+                break;
+            }
+            buf[start + len++] = textSymbol(buf[i]);
+        }
+        if (!ucv_feed(uv, buf + start, len)) break;
+        start = 0;
+        if (!done){
+            got = fread(buf, 1, STREAM_BUFFER, fptr);
+            *bytes += got;
+        }
+    }
+
+    ok = ucv_finish(uv);
+    ucv_close(uv);
+    free(buf);
+    return ok;
+}
+
+// Verify the cycle read from fptr in one pass (see verifyStreamRange).
+// Returns 1 if the cycle is valid, 0 if not and -1 if it could not be read
+int verifyStream(FILE *fptr, int n){
+    unsigned long long bytes;
+    return verifyStreamRange(fptr, NULL, 0, &n, 0, ~0ull, &bytes);
+}
+
+// Verify the cycle read from fptr keeping the bitmap within budget bytes.
+// The ranks are split into ranges of budget*8 and the whole input is read
+// again for each range, so fptr has to be seekable if it takes more than
+// one pass. That is checked from n (or the container's header) before 
+// anything past the header is read. n! is 87G for n = 14, so with an
+// 8 GB budget its cycle takes two passes instead of an 11 GB bitmap. 
+// Each pass and the total read are reported to report if it is not 
+// NULL. Returns 1 if the cycle is valid, 0 if not and -1 if it could 
+// not be read
+int verifyStreamBudget(FILE *fptr, int n, unsigned long long budget, FILE *report){
+    unsigned long long span = budget < (1ull << 60) ? budget * 8 : ~0ull;
+    unsigned long long length = ~0ull, total = 0;
+    if (span < 64) span = 64;
+
+    // Find out how many passes it takes before reading the cycle, a
+    // stream that can't be rewound has to manage with one
+    unsigned char head[STREAM_PEEK];
+    size_t got = fread(head, 1, sizeof(head), fptr);
+    int m = ucfile_is_container(head, got) ? ucfile_header_n(head, got) : n;
+    int seekable = fseek(fptr, 0, SEEK_SET) == 0;
+    if (seekable) got = 0;
+    else if (m >= 1 && m <= maxN && factorial(m) > span){
+        fprintf(stderr, "Error the input can't be reread, it needs %llu passes within the budget\n", (factorial(m) + span - 1) / span);
+        return -1;
+    }
+
+    int ok = 1;
+    for (unsigned long long lo = 0, pass = 1; ok == 1 && lo < length; lo += span, pass++){
+        if (pass > 1 && fseek(fptr, 0, SEEK_SET) != 0){
+            fprintf(stderr, "Error the input can't be reread\n");
+            return -1;
+        }
+
+        unsigned long long bytes;
+        double start = now();
+        ok = verifyStreamRange(fptr, head, pass == 1 ? got : 0, &n, lo, lo + span, &bytes);
+        if (ok < 0) return -1;
+        length = factorial(n);
+        total += bytes;
+
+        unsigned long long hi = length - lo < span ? length : lo + span;
+        if (report) fprintf(report, "pass %llu/%llu: ranks %llu..%llu, %.1f MB read in %.2fs%s\n", pass, (length + span - 1) / span, lo, hi - 1, bytes / 1e6, now() - start, ok ? "" : ", failed");
+    }
+
+    if (report) fprintf(report, "%.1f MB read in total\n", total / 1e6);
+    return ok;
+}
+
+
+// Sharded verification, as if over several hosts. Shard k owns the ranks
+// k*span..(k+1)*span-1 (span = ⌈n!/shards⌉) and scans the same share of 
+// the windows. The scan marks the ranks it owns in the shard's bitmap 
+// and sends every other rank to its owner through a partition file in a
+// directory all the shards can see. The merge then marks what every 
+// other shard sent it, and the coordinator reads the bitmaps back to 
+// check that each one is full. A rank seen twice fails the shard that
+// owns it at once. Shards are local processes here, but each step only
+// needs the input, the directory and its shard number
+#define SHARD_BATCH 4096
+#define SHARD_PATH 4096
+
+// Where the symbols of the cycle come from, a UC text file or a container
+typedef struct {
+    unsigned char *map;
+    unsigned long long size;
+    UCFile *file;
+    VerifyRange text;               // for stageSymbols
+} ShardSource;
+
+static int openShardSource(const char *path, int *n, ShardSource *src){
+    memset(src, 0, sizeof(ShardSource));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0){
+        fprintf(stderr, "Error opening %s\n", path);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+
+    src->size = st.st_size;
+    src->map = mmap(NULL, src->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (src->map == MAP_FAILED){
+        fprintf(stderr, "Error mapping %s\n", path);
+        src->map = NULL;
+        return 0;
+    }
+
+    if (ucfile_is_container(src->map, src->size)){
+        munmap(src->map, src->size);
+        src->map = NULL;
+        src->file = ucfile_open(path);
+        if (!src->file) return 0;
+        *n = ucfile_n(src->file);
+        src->text.len = ucfile_length(src->file);
+        return 1;
+    }
+
+    unsigned long long L = src->size;
+    while (L > 0 && (src->map[L - 1] == '\n' || src->map[L - 1] == '\r')) L--;
+    src->text.text = src->map;
+    src->text.len = L;
+    return 1;
+}
+
+static void closeShardSource(ShardSource *src){
+    if (src->map) munmap(src->map, src->size);
+    if (src->file) ucfile_close(src->file);
+}
+
+// Copy symbols first..first+len-1 (wrapping round the end) to out. 
+// Returns 0 if a chunk of a container fails its checksum
+static int shardSymbols(const ShardSource *src, unsigned long long first, unsigned long long len, unsigned char *out){
+    if (!src->file){
+        stageSymbols(&src->text, first, len, out);
+        return 1;
+    }
+    for (unsigned long long t = 0; t < len; ){
+        unsigned long long i = (first + t) % src->text.len;
+        unsigned long long run = src->text.len - i < len - t ? src->text.len - i : len - t;
+        if (ucfile_read(src->file, i, out + t, run) < run){
+            fprintf(stderr, "Error a chunk holding symbol %llu fails its checksum\n", i);
+            return 0;
+        }
+        t += run;
+    }
+    return 1;
+}
+
+// Put the path of a shard file in out (SHARD_PATH bytes). Returns 0 if
+// it doesn't fit
+static int shardPath(char *out, const char *dir, const char *kind, int from, int to){
+    int len = to < 0 ? snprintf(out, SHARD_PATH, "%s/%s-%d", dir, kind, from)
+                     : snprintf(out, SHARD_PATH, "%s/%s-%d-%d", dir, kind, from, to);
+    if (len < 0 || len >= SHARD_PATH){
+        fprintf(stderr, "Error the shard directory name is too long\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int writeFile(const char *path, const void *data, unsigned long long size){
+    FILE *fptr = fopen(path, "wb");
+    int ok = fptr && fwrite(data, 1, size, fptr) == size;
+    if (fptr) ok &= fclose(fptr) == 0;
+    if (!ok) fprintf(stderr, "Error writing %s\n", path);
+    return ok;
+}
+
+static int readFile(const char *path, void *data, unsigned long long size){
+    FILE *fptr = fopen(path, "rb");
+    int ok = fptr && fread(data, 1, size, fptr) == size;
+    if (fptr) fclose(fptr);
+    if (!ok) fprintf(stderr, "Error reading %s\n", path);
+    return ok;
+}
+
+// Scan the windows of shard k, writing its bitmap to dir/seen-k and the
+// ranks owned by shard j to dir/part-k-j. Returns 1 if every window was a
+// permutation and no owned rank came up twice, 0 if not and -1 on error
+int verifyShardScan(const char *path, int n, int shards, int k, const char *dir){
+    ShardSource src;
+    if (!openShardSource(path, &n, &src)) return -1;
+    unsigned long long L = src.text.len;
+    if (n < 3 || n > maxN || shards < 1 || k < 0 || k >= shards || L != factorial(n)){
+        closeShardSource(&src);
+        return n < 3 || n > maxN || shards < 1 || k < 0 || k >= shards ? -1 : 0;
+    }
+
+    unsigned long long span = (L + shards - 1) / shards;
+    unsigned long long from = L * k / shards, to = L * (k + 1) / shards;
+    unsigned long long words = (span + 63) / 64;
+    VerifyRange own = { .n = n, .threads = 1, .seen = calloc(words, sizeof(unsigned long long)) };
+    unsigned char *sym = malloc(SLIDE_BLOCK + n);
+    long long *ranks = malloc(SLIDE_BLOCK * sizeof(long long));
+    unsigned long long *batch = malloc((unsigned long long)shards * SHARD_BATCH * sizeof(unsigned long long));
+    unsigned int *fill = calloc(shards, sizeof(unsigned int));
+    FILE **part = calloc(shards, sizeof(FILE *));
+    int ok = own.seen && sym && ranks && batch && fill && part ? 1 : -1;
+    if (ok < 0) fprintf(stderr, "Error memory allocation failed\n");
+
+    char name[SHARD_PATH];
+    for (int j = 0; ok == 1 && j < shards; j++){
+        if (j == k) continue;
+        part[j] = shardPath(name, dir, "part", k, j) ? fopen(name, "wb") : NULL;
+        if (!part[j]){
+            fprintf(stderr, "Error writing %s\n", name);
+            ok = -1;
+        }
+    }
+
+    Slider sl;
+    if (ok == 1){
+        ok = shardSymbols(&src, from, n - 1, sym) ? sliderInit(&sl, n, sym) : -1;
+    }
+    for (unsigned long long base = from; ok == 1 && base < to; base += SLIDE_BLOCK){
+        unsigned long long len = to - base < SLIDE_BLOCK ? to - base : SLIDE_BLOCK;
+        ok = shardSymbols(&src, base, len + n - 1, sym) ? slide(&sl, sym, len, ranks) : -1;
+
+        for (unsigned long long t = 0; ok == 1 && t < len; t++){
+            int j = ranks[t] / span;
+            if (j == k) ok = markRank(&own, ranks[t] - k * span);
+            else{
+                batch[(unsigned long long)j * SHARD_BATCH + fill[j]++] = ranks[t];
+                if (fill[j] == SHARD_BATCH && fwrite(batch + (unsigned long long)j * SHARD_BATCH, sizeof(unsigned long long), SHARD_BATCH, part[j]) != SHARD_BATCH) ok = -1;
+                if (fill[j] == SHARD_BATCH) fill[j] = 0;
+            }
+        }
+    }
+
+    for (int j = 0; j < shards; j++){
+        if (!part[j]) continue;
+        if (ok == 1 && fwrite(batch + (unsigned long long)j * SHARD_BATCH, sizeof(unsigned long long), fill[j], part[j]) != fill[j]) ok = -1;
+        if (fclose(part[j]) != 0) ok = -1;
+    }
+    if (ok == 1 && !(shardPath(name, dir, "seen", k, -1) && writeFile(name, (void *)own.seen, words * sizeof(unsigned long long)))) ok = -1;
+
+    closeShardSource(&src);
+    free((void *)own.seen);
+    free(sym);
+    free(ranks);
+    free(batch);
+    free(fill);
+    free(part);
+    return ok;
+}
+
+// Mark the ranks every other shard sent shard k in its bitmap, once they
+// have all finished their scan. Returns 1 if none of them was already
+// marked, 0 if one was and -1 on error
+int verifyShardMerge(int n, int shards, int k, const char *dir){
+    if (n < 3 || n > maxN || shards < 1 || k < 0 || k >= shards) return -1;
+    unsigned long long L = factorial(n);
+    unsigned long long span = (L + shards - 1) / shards;
+    unsigned long long words = (span + 63) / 64;
+    VerifyRange own = { .n = n, .threads = 1, .seen = malloc(words * sizeof(unsigned long long)) };
+    unsigned long long *batch = malloc(SHARD_BATCH * sizeof(unsigned long long));
+    if (!own.seen || !batch){
+        fprintf(stderr, "Error memory allocation failed\n");
+        free((void *)own.seen);
+        free(batch);
+        return -1;
+    }
+
+    char name[SHARD_PATH];
+    int ok = shardPath(name, dir, "seen", k, -1) && readFile(name, (void *)own.seen, words * sizeof(unsigned long long)) ? 1 : -1;
+    for (int j = 0; ok == 1 && j < shards; j++){
+        if (j == k) continue;
+        FILE *fptr = shardPath(name, dir, "part", j, k) ? fopen(name, "rb") : NULL;
+        if (!fptr){
+            fprintf(stderr, "Error reading %s\n", name);
+            ok = -1;
+            break;
+        }
+
+        size_t got;
+        while (ok == 1 && (got = fread(batch, sizeof(unsigned long long), SHARD_BATCH, fptr)) > 0){
+            for (size_t t = 0; ok == 1 && t < got; t++){
+                unsigned long long r = batch[t] - k * span;
+                ok = r < span && markRank(&own, r);
+            }
+        }
+        fclose(fptr);
+    }
+    if (ok == 1 && !(shardPath(name, dir, "seen", k, -1) && writeFile(name, (void *)own.seen, words * sizeof(unsigned long long)))) ok = -1;
+
+    free((void *)own.seen);
+    free(batch);
+    return ok;
+}
+
+// The coordinator's verdict once every shard has merged, 1 if the 
+// bitmap of each shard has all of its ranks marked, 0 if not and -1 if
+// a bitmap could not be read
+int verifyShardsMerged(int n, int shards, const char *dir){
+    if (n < 3 || n > maxN || shards < 1) return -1;
+    unsigned long long L = factorial(n);
+    unsigned long long span = (L + shards - 1) / shards;
+    unsigned long long words = (span + 63) / 64;
+    unsigned long long *seen = malloc(words * sizeof(unsigned long long));
+    if (!seen) return -1;
+
+    int ok = 1;
+    char name[SHARD_PATH];
+    for (int k = 0; ok == 1 && k < shards; k++){
+        unsigned long long owned = L - k * span < span ? L - k * span : span;
+        if (!shardPath(name, dir, "seen", k, -1) || !readFile(name, seen, words * sizeof(unsigned long long))) ok = -1;
+
+        unsigned long long marked = 0;
+        for (unsigned long long w = 0; ok == 1 && w < words; w++) marked += __builtin_popcountll(seen[w]);
+        if (ok == 1 && marked != owned) ok = 0;
+    }
+    free(seen);
+    return ok;
+}
+
+// Run one step on every shard, each in its own process, and return the
+// worst result. A shard we can't fork for runs in this process
+static int runShards(const char *path, int n, int shards, const char *dir, int merge){
+    pid_t *pid = malloc(shards * sizeof(pid_t));
+    if (!pid) return -1;
+
+    int ok = 1;
+    for (int k = 0; k < shards; k++){
+        pid[k] = fork();
+        if (pid[k] == 0){
+            int r = merge ? verifyShardMerge(n, shards, k, dir) : verifyShardScan(path, n, shards, k, dir);
+            _exit(r == 1 ? 0 : r == 0 ? 1 : 2);
+        }
+        if (pid[k] < 0){
+            int r = merge ? verifyShardMerge(n, shards, k, dir) : verifyShardScan(path, n, shards, k, dir);
+            if (r < ok) ok = r;
+        }
+    }
+    for (int k = 0; k < shards; k++){
+        int status;
+        if (pid[k] <= 0) continue;
+        if (waitpid(pid[k], &status, 0) != pid[k] || !WIFEXITED(status) || WEXITSTATUS(status) == 2) ok = -1;
+        else if (WEXITSTATUS(status) == 1 && ok > 0) ok = 0;
+    }
+    free(pid);
+    return ok;
+}
+
+// Verify the UC text file or container at path with shards local 
+// processes exchanging ranks through dir (a fresh directory in /tmp if
+// dir is NULL). n is only needed for text. The two steps, the ranks 
+// exchanged and the verdict are reported to report if it is not NULL.
+// Returns 1 if the cycle is valid, 0 if not and -1 on error
+int verifySharded(const char *path, int n, int shards, const char *dir, FILE *report){
+    ShardSource src;
+    if (!openShardSource(path, &n, &src)) return -1;
+    unsigned long long L = src.text.len;
+    closeShardSource(&src);
+    if (n < 3 || n > maxN){
+        fprintf(stderr, "Error sharded verification needs 3 <= n <= %d\n", maxN);
+        return -1;
+    }
+    if (L != factorial(n)) return 0;
+    if (shards < 1) shards = 1;
+    if ((unsigned long long)shards > L) shards = L;
+
+    char tmp[] = "/tmp/ucshard-XXXXXX";
+    if (!dir && !(dir = mkdtemp(tmp))){
+        fprintf(stderr, "Error making a directory for the shards\n");
+        return -1;
+    }
+
+    // The longest name any shard uses has to fit
+    char name[SHARD_PATH];
+    if (!shardPath(name, dir, "part", shards - 1, shards - 1)){
+        if (dir == tmp) rmdir(tmp);
+        return -1;
+    }
+
+    // All the scans have to finish before any merge starts
+    double start = now();
+    int ok = runShards(path, n, shards, dir, 0);
+    if (report) fprintf(report, "scan: %d shards in %.2fs\n", shards, now() - start);
+
+    unsigned long long sent = 0;
+    for (int k = 0; k < shards; k++) for (int j = 0; j < shards; j++){
+        struct stat st;
+        if (j != k && shardPath(name, dir, "part", k, j) && stat(name, &st) == 0) sent += st.st_size;
+    }
+
+    if (ok == 1){
+        start = now();
+        ok = runShards(path, n, shards, dir, 1);
+        if (report) fprintf(report, "merge: %llu ranks exchanged (%.1f MB) in %.2fs\n", sent / sizeof(unsigned long long), sent / 1e6, now() - start);
+    }
+    if (ok == 1) ok = verifyShardsMerged(n, shards, dir);
+    if (report) fprintf(report, "verdict: %s\n", ok == 1 ? "valid" : ok == 0 ? "not valid" : "error");
+
+    for (int k = 0; k < shards; k++){
+        if (shardPath(name, dir, "seen", k, -1)) unlink(name);
+        for (int j = 0; j < shards; j++) if (shardPath(name, dir, "part", k, j)) unlink(name);
+    }
+    if (dir == tmp) rmdir(tmp);
+    return ok;
+}
+
+// Time the direct and the partitioned verifier on the cycle for each n
+// from lo to hi and write the windows per second of each to fptr
+void benchmarkVerification(int lo, int hi, int threads, FILE *fptr){
+    fprintf(fptr, "%3s %12s %16s %16s %8s\n", "n", "windows", "direct win/s", "partition win/s", "speedup");
+
+    for (int n = lo < 3 ? 3 : lo; n <= hi && n <= maxN; n++){
+        fact = factorial(n);
+        UCBuffer *uc = generateUniversalCycleParallel(n, UC_BYTE, threads);
+        if (!uc){
+            fprintf(stderr, "Error generating universal cycle for n = %d\n", n);
+            return;
+        }
+
+        double start = now();
+        int direct = isUniversalCycleParallel(uc, n, threads);
+        double t0 = now() - start;
+        start = now();
+        int partitioned = isUniversalCyclePartitioned(uc, n, threads);
+        double t1 = now() - start;
+        if (!direct || !partitioned) fprintf(stderr, "Warning: n = %d was not verified\n", n);
+
+        fprintf(fptr, "%3d %12llu %16.0f %16.0f %7.2fx\n", n, fact, fact / t0, fact / t1, t0 / t1);
+        freeUCBuffer(uc);
+    }
+}
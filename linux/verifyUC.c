@@ -0,0 +1,55 @@
+#include "constructAndRank.h"
+
+// verifyUC [-n <n>] [-b <MB>] [-s <shards> [-d <dir>]] [file]
+//
+// Checks that a universal cycle is valid without holding it in memory,
+// so it can sit at the end of a pipe, e.g. 'echo 12 | ./run -s | ./verifyUC -n 12'.
+// Reads the file, or stdin if there is none, as either a binary container
+// or text as written by run. n is only needed for text. Prints YES or no
+// and exits with 0 if the cycle is valid, 1 if not and 2 if the input
+// could not be read
+//
+// '-b <MB>' keeps the rank bitmap (n!/8 bytes, 11 GB for n = 14) within
+// that many MB by reading the input once per slice of the ranks, which 
+// needs a file rather than a pipe once it takes more than one pass. The
+// passes and the MB read are reported on stderr
+//
+// '-s <shards>' splits the work between that many processes, each owning
+// a slice of the ranks, which swap ranks through files in '-d <dir>' (a
+// fresh directory in /tmp by default). It needs a file
+int main(int argc, char **argv){
+  int n = 0;
+  unsigned long long budget = 0;
+  int shards = 0;
+  const char *path = NULL, *dir = NULL;
+  for (int i = 1; i < argc; i++){
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) n = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) shards = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) dir = argv[++i];
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) budget = strtoull(argv[++i], NULL, 10) << 20;
+    else path = argv[i];
+  }
+
+  if (shards > 0){
+    if (!path){
+      fprintf(stderr, "Error sharded verification needs a file\n");
+      return 2;
+    }
+    int ok = verifySharded(path, n, shards, dir, stderr);
+    if (ok < 0) return 2;
+    printf("%s\n", ok ? "YES" : "no");
+    return !ok;
+  }
+
+  FILE *fptr = path ? fopen(path, "rb") : stdin;
+  if (fptr == NULL){
+    fprintf(stderr, "Error opening %s\n", path);
+    return 2;
+  }
+
+  int ok = budget ? verifyStreamBudget(fptr, n, budget, stderr) : verifyStream(fptr, n);
+  if (path) fclose(fptr);
+  if (ok < 0) return 2;
+  printf("%s\n", ok ? "YES" : "no");
+  return !ok;
+}